@@ -14,6 +14,14 @@
 #include <set>
 #include <tuple>
 #include <limits>
+#include <algorithm>
+
+#include "srpg/ActionQueue.h"
+#include "srpg/Battle.h"
+#include "srpg/EnemyTurnJob.h"
+#include "srpg/Mcts.h"
+#include "srpg/Skirmish.h"
+#include "srpg/ThreatMap.h"
 
 #include "externals/imgui/imgui.h"
 #include "externals/imgui/imgui_impl_dx12.h"
@@ -80,388 +88,437 @@ Matrix4x4 Inverse(const Matrix4x4& m);
 /// TR1_LLM_SRPG用の設定
 ///----------------------------------------------------------------------------
 
-std::deque<std::string> combat_log;
-constexpr size_t MAX_LOG_SIZE = 10;
-
 // ------------------------
-// マップとユニット情報
+// 戦闘の状態(ルールはsrpg/Battleにまとめてある)
 // ------------------------
 constexpr int TILE_SIZE = 32; // タイルのサイズ
-constexpr int MAP_SIZE = 16;  // マップのサイズ(16x16)
 
-// タイルの種類
-enum TileType {
-	PLAIN = 0,  // 平地
-	FOREST = 1  // 森
-};
+BattleState battle = make_default_battle(); // 現在の戦闘
+BattleEventWriter battle_events;             // 現在の戦闘の出来事の記録(Save Replayでファイルに書き出す)
+EnemyTurnJob enemy_turn_job;                 // エネミーターンの計算(別スレッドで行う)
+bool use_mcts_ai = false;                    // エネミーターンをMCTSで計画するかどうか
+MctsConfig mcts_config;                      // MCTSの設定
+bool use_endgame_search = false;             // 残りのユニットが少ないときにアルファベータ探索を使うかどうか
+SkirmishConfig endgame_config;               // 終盤の探索の設定
 
-// ターンのフェーズ
-enum Phase {
-	PlayerTurn, // プレイヤーターン
-	EnemyTurn   // エネミーターン
-};
-Phase current_phase = PlayerTurn; // 現在のフェーズ(開始時はプレイヤーターン)
+int selected_unit_index = -1;  // 選択中のユニットインデックス
+TileSet current_move_range; // 現在の移動可能範囲(ユニットの移動力に基づく)
+TileSet current_attack_range; // 現在の攻撃可能範囲(ユニットの攻撃範囲に基づく)
+bool show_threat_map = false; // 敵の脅威範囲を表示するかどうか
+ThreatMap enemy_threat;       // 敵の脅威範囲(盤面が変わったときだけ計算し直す)
 
-// ユニットの武器タイプ
-enum class WeaponType {
-	Sword,      // 剣(近接)
-	Bow         // 弓(遠距離)
-};
+// ------------------------
+// エネミーターンの再生
+// ------------------------
 
-// マップの定義
-int map[MAP_SIZE][MAP_SIZE] = {
-//   0 1 2 3 4 5 6 7 8 9.0.1.2.3.4.5
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//0
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//1
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//2
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//3
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//4
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//5
-	{0,0,0,0,0,1,0,0,0,0,1,0,0,0,0,0},//6
-	{0,0,0,0,0,1,1,0,1,0,1,0,0,0,0,0},//7
-	{0,0,0,0,0,1,0,1,0,1,1,0,0,0,0,0},//8
-	{0,0,0,0,0,1,0,0,0,0,1,0,0,0,0,0},//9
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//10
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//11
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//12
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//13
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//14
-	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//15
+// ユニットの移動アニメーション(マス単位の座標)
+struct UnitAnimation {
+	int unit;
+	float from_x, from_y;
+	float to_x, to_y;
+	float elapsed = 0.0f;
 };
 
-// ユニット情報
-struct Unit {
-	std::string name;          // ユニット名
-	int x, y;                  // 位置
-	bool is_enemy;             // 敵かどうか
-	int hp;                    // hp
-	int move = 3;              // 移動力
-	bool has_moved = false;    // 移動済みかどうか
-	bool has_attacked = false; // 攻撃済みかどうか
-	int atk = 5;               // 攻撃力
-	int def = 2;               // 防御力
-
-	WeaponType weapon = WeaponType::Sword; // 武器タイプ
-
-	// 最小攻撃範囲
-	int min_range() const {
-		return weapon == WeaponType::Sword ? 1 : 2;
-	}
-	// 最大攻撃範囲
-	int max_range() const {
-		return weapon == WeaponType::Sword ? 1 : 2;
-	}
+// 計算済みのエネミーターンを少しずつ盤面に適用して見せる
+struct EnemyTurnPlayback {
+	static constexpr float kMoveSeconds = 0.15f;   // 1体の移動にかける時間(行動の間隔の上限)
+	static constexpr float kMaxTurnSeconds = 3.0f; // 敵が多くてもこの時間で終わるように行動の間隔を詰める
+	static constexpr double kApplyBudgetMs = 4.0;  // 1フレームで行動の適用に使う時間の上限
+
+	bool active = false;                  // 再生中かどうか
+	EnemyActionQueue queue;               // 適用待ちの行動
+	float interval = 0.0f;                // 行動の間隔(秒)
+	float timer = 0.0f;                   // 前の行動からの経過時間
+	std::vector<UnitAnimation> animations;
+	std::vector<uint8_t> animating;       // ユニットごとの移動中フラグ
 };
+EnemyTurnPlayback enemy_playback;
 
-// ユニットの初期化
-std::vector<Unit> units = {
-	{"ally1", 9, 12, false, 20, 3, false, false, 7, 3, WeaponType::Sword},  // 味方ユニット
-	{"ally2", 6, 12, false, 15, 2, false, false, 5, 2, WeaponType::Bow},
-	{"enemy1", 6, 3, true, 20, 3, false, false, 7, 3, WeaponType::Sword},  // 敵ユニット
-	{"enemy2", 9, 3, true, 15, 2, false, false, 5, 2, WeaponType::Bow}
+// ------------------------
+// マップの表示範囲
+// ------------------------
+
+// マップの表示範囲(パンとズーム)
+struct MapCamera {
+	static constexpr float kMinZoom = 0.25f;
+	static constexpr float kMaxZoom = 4.0f;
+
+	float zoom = 1.0f;               // 拡大率
+	ImVec2 scroll = { 0.0f, 0.0f };  // 表示領域の左上に来るマップ上の位置(拡大後のピクセル)
 };
+MapCamera camera;
 
-int selected_unit_index = -1;  // 選択中のユニットインデックス
-std::set<std::pair<int, int>> current_move_range; // 現在の移動可能範囲(ユニットの移動力に基づく)
-std::set<std::pair<int, int>> current_attack_range; // 現在の攻撃可能範囲(ユニットの攻撃範囲に基づく)
+// 表示領域に入っているマスの範囲([x0, x1) x [y0, y1))
+struct TileRect {
+	int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	bool operator==(const TileRect&) const = default;
+};
 
 // ------------------------
-// ImGui関数
+// タイル描画のキャッシュ
 // ------------------------
 
-// マップのサイズとタイルのサイズを基に、ウィンドウのクライアント領域を設定
-bool is_within_bounds(int x, int y) {
-	return x >= 0 && y >= 0 && x < MAP_SIZE && y < MAP_SIZE;
-}
-
-// タイルが進行可能かどうかを判定する関数
-bool is_tile_passable(int x, int y) {
-	return map[y][x] != FOREST; // 森を通れない
-}
+// マップのタイルの色と頂点をまとめたもの
+// マスの色は盤面か表示中の範囲が変わったときだけ計算し直し、
+// 頂点は表示領域に入っているマスの分だけ作って、毎フレームは描画リストにコピーするだけにする
+struct TileBatch {
+	static constexpr int kQuadsPerChunk = 0xFFFF / 4; // 16bitの添字で描ける四角形の数
+
+	std::vector<ImU32> colors;        // マスごとの色(行優先)
+	std::vector<ImU32> overlays;      // マスごとに重ねる色(脅威範囲、0なら重ねない)
+	uint64_t revision = ~0ull;        // 色を作ったときのbattle.revision
+	bool dirty = true;                // 範囲の表示が変わったら立てる
+
+	std::vector<ImDrawVert> vertices; // マップ左上を(0,0)とした頂点(四角形ごとに4頂点)
+	std::vector<ImDrawIdx> indices;   // チャンク内の添字(四角形ごとに6個、描画時に先頭の頂点番号を足す)
+	TileRect visible;                 // 頂点を作ったときの表示範囲
+	float zoom = 0.0f;                // 頂点を作ったときの拡大率
+	bool vertices_dirty = true;
+};
+TileBatch tile_batch;
 
-// ユニットがその位置にいるかどうかを判定する関数
-bool is_occupied(int x, int y) {
-	for (const auto& u : units) {
-		if (u.hp > 0 && u.x == x && u.y == y) return true;
-	}
-	return false;
-}
+// ------------------------
+// ImGui関数
+// ------------------------
 
-// ユニットの移動範囲を計算する関数
-std::set<std::pair<int, int>> get_move_range(const Unit& unit) {
-	std::set<std::pair<int, int>> result;
-	std::queue<std::tuple<int, int, int>> q;
-	q.push({ unit.x, unit.y, 0 });
-
-	while (!q.empty()) {
-		auto [x, y, d] = q.front(); q.pop();
-		if (d > unit.move) continue;
-		if (!is_within_bounds(x, y) || !is_tile_passable(x, y)) continue;
-		if (result.count({ x, y })) continue;
-		result.insert({ x, y });
-
-		q.push({ x + 1, y, d + 1 });
-		q.push({ x - 1, y, d + 1 });
-		q.push({ x, y + 1, d + 1 });
-		q.push({ x, y - 1, d + 1 });
-	}
-	return result;
+// 四角形を1つ頂点バッファに追加する関数
+void AddBatchQuad(TileBatch& batch, ImVec2 tl, ImVec2 br, ImU32 color, ImVec2 uv) {
+	ImDrawIdx base = (ImDrawIdx)((batch.vertices.size() / 4 % TileBatch::kQuadsPerChunk) * 4);
+	batch.vertices.push_back({ tl, uv, color });
+	batch.vertices.push_back({ ImVec2(br.x, tl.y), uv, color });
+	batch.vertices.push_back({ br, uv, color });
+	batch.vertices.push_back({ ImVec2(tl.x, br.y), uv, color });
+	const ImDrawIdx quad[6] = { 0, 1, 2, 0, 2, 3 };
+	for (ImDrawIdx k : quad) batch.indices.push_back((ImDrawIdx)(base + k));
 }
 
-// ユニットの攻撃範囲を計算する関数
-std::set<std::pair<int, int>> get_attack_range(const Unit& unit) {
-	std::set<std::pair<int, int>> result;
-	for (int dx = -unit.max_range(); dx <= unit.max_range(); ++dx) {
-		for (int dy = -unit.max_range(); dy <= unit.max_range(); ++dy) {
-			int dist = abs(dx) + abs(dy);
-			if (dist >= unit.min_range() && dist <= unit.max_range()) {
-				int tx = unit.x + dx;
-				int ty = unit.y + dy;
-				if (is_within_bounds(tx, ty)) {
-					result.insert({ tx, ty });
-				}
+// マスの色を計算し直す関数
+void BuildTileColors(TileBatch& batch) {
+	const TileMap& map = battle.map;
+	batch.colors.resize((size_t)map.width() * map.height());
+	batch.overlays.assign((size_t)map.width() * map.height(), 0);
+
+	if (show_threat_map) update_threat_map(battle, true, enemy_threat);
+
+	for (int y = 0; y < map.height(); ++y) {
+		for (int x = 0; x < map.width(); ++x) {
+			ImU32 color = IM_COL32(200, 200, 200, 255); // 平地の色
+			switch (map.at(x, y)) {
+			case FOREST: color = IM_COL32(100, 200, 100, 255); break; // 森の色
+			case HILL: color = IM_COL32(190, 160, 110, 255); break;   // 丘の色
+			case WATER: color = IM_COL32(90, 150, 220, 255); break;   // 水辺の色
+			}
+			// マスの移動可能範囲
+			if (current_move_range.contains(x, y)) color = IM_COL32(100, 100, 255, 180);
+			// マスの攻撃可能範囲
+			if (current_attack_range.contains(x, y)) color = IM_COL32(255, 100, 100, 180);
+			size_t i = (size_t)y * map.width() + x;
+			batch.colors[i] = color;
+
+			// 敵の脅威範囲(攻撃できる敵が多いマスほど濃くする)
+			int threat = show_threat_map ? enemy_threat.count_at(x, y) : 0;
+			if (threat > 0) {
+				int alpha = std::min(40 + 40 * threat, 200);
+				batch.overlays[i] = IM_COL32(255, 140, 0, alpha);
 			}
 		}
 	}
-	return result;
-}
 
-void log(const std::string& msg) {
-	combat_log.push_front(msg);
-	if (combat_log.size() > MAX_LOG_SIZE) combat_log.pop_back();
+	batch.revision = battle.revision;
+	batch.dirty = false;
+	batch.vertices_dirty = true;
 }
 
-// ユニットを攻撃する関数
-void attack(Unit& attacker, Unit& target) {
-	int damage = std::max(0, attacker.atk - target.def);
-	target.hp -= damage;
-	log(attacker.name + " Attack! " + target.name + " Deals " + std::to_string(damage) + " Damage ");
-
-	if (target.hp <= 0) {
-		log(target.name + " Is Defeted ");
-		return;
+// 表示範囲のマスの頂点を作り直す関数
+void BuildTileVertices(TileBatch& batch, const TileRect& visible, float zoom) {
+	const TileMap& map = battle.map;
+	const ImVec2 uv = ImGui::GetFontTexUvWhitePixel();
+	const float tile = TILE_SIZE * zoom;
+	batch.vertices.clear();
+	batch.indices.clear();
+
+	for (int y = visible.y0; y < visible.y1; ++y) {
+		for (int x = visible.x0; x < visible.x1; ++x) {
+			size_t i = (size_t)y * map.width() + x;
+			ImVec2 tl = { x * tile, y * tile };
+			ImVec2 br = { tl.x + tile, tl.y + tile };
+			AddBatchQuad(batch, tl, br, batch.colors[i], uv);
+			if (batch.overlays[i]) AddBatchQuad(batch, tl, br, batch.overlays[i], uv);
+		}
 	}
 
-	// 反撃処理
-	if (target.hp > 0) {
-		auto counter_range = get_attack_range(target);
-		if (counter_range.count({ attacker.x, attacker.y })) {
-			int counter = std::max(0, target.atk - attacker.def);
-			attacker.hp -= counter;
-			log(target.name + " Counter! " + attacker.name + " Deals " + std::to_string(counter) + " Damage!! ");
-			if (attacker.hp <= 0) log(attacker.name + " Is Defeted ");
-		}
+	// マスの枠線(マスごとに枠を描く代わりに、表示範囲の縦横の線をまとめて描く)
+	const float left = visible.x0 * tile;
+	const float top = visible.y0 * tile;
+	const float right = visible.x1 * tile;
+	const float bottom = visible.y1 * tile;
+	for (int x = visible.x0; x <= visible.x1; ++x) {
+		float lx = x * tile;
+		AddBatchQuad(batch, ImVec2(lx, top), ImVec2(lx + 1.0f, bottom), IM_COL32(0, 0, 0, 255), uv);
+	}
+	for (int y = visible.y0; y <= visible.y1; ++y) {
+		float ly = y * tile;
+		AddBatchQuad(batch, ImVec2(left, ly), ImVec2(right, ly + 1.0f), IM_COL32(0, 0, 0, 255), uv);
 	}
+
+	batch.visible = visible;
+	batch.zoom = zoom;
+	batch.vertices_dirty = false;
 }
 
-// プレイヤーターンを終了する関数
-void end_player_turn() {
-	for (auto& u : units) {
-		if (!u.is_enemy) {
-			u.has_moved = false;
-			u.has_attacked = false;
+// タイルの頂点を描画リストに流し込む関数(16bitの添字に収まるようにチャンクに分ける)
+void EmitTileBatch(ImDrawList* draw_list, const TileBatch& batch, ImVec2 origin) {
+	const int quad_count = (int)(batch.vertices.size() / 4);
+	for (int first = 0; first < quad_count; first += TileBatch::kQuadsPerChunk) {
+		int quads = std::min(TileBatch::kQuadsPerChunk, quad_count - first);
+		draw_list->PrimReserve(quads * 6, quads * 4);
+
+		const ImDrawVert* src = batch.vertices.data() + first * 4;
+		for (int k = 0; k < quads * 4; ++k) {
+			draw_list->_VtxWritePtr[k] = src[k];
+			draw_list->_VtxWritePtr[k].pos.x += origin.x;
+			draw_list->_VtxWritePtr[k].pos.y += origin.y;
 		}
+		const ImDrawIdx* idx = batch.indices.data() + first * 6;
+		const ImDrawIdx base = (ImDrawIdx)draw_list->_VtxCurrentIdx;
+		for (int k = 0; k < quads * 6; ++k) draw_list->_IdxWritePtr[k] = (ImDrawIdx)(base + idx[k]);
+
+		draw_list->_VtxWritePtr += quads * 4;
+		draw_list->_IdxWritePtr += quads * 6;
+		draw_list->_VtxCurrentIdx += quads * 4;
 	}
-	current_phase = EnemyTurn;
 }
 
-// エネミーターンのロジック
-void enemy_turn_logic() {
-	for (auto& enemy : units) {
-		if (!enemy.is_enemy || enemy.hp <= 0) continue;
-
-		// 最も近いプレイヤーユニットを探す
-		int closest_dist = std::numeric_limits<int>::max();
-		Unit* target_unit = nullptr;
-
-		for (auto& ally : units) {
-			if (ally.is_enemy || ally.hp <= 0) continue;
-			int dist = std::abs(enemy.x - ally.x) + std::abs(enemy.y - ally.y);
-			if (dist < closest_dist) {
-				closest_dist = dist;
-				target_unit = &ally;
-			}
+// ホイールでのズームと右ドラッグでのパンを処理する関数
+void UpdateCamera(ImVec2 view_pos, ImVec2 view_size) {
+	ImGuiIO& io = ImGui::GetIO();
+	const TileMap& map = battle.map;
+
+	if (ImGui::IsWindowHovered()) {
+		// カーソルの下にあるマップ上の位置が動かないように拡大率を変える
+		if (io.MouseWheel != 0.0f) {
+			float old_zoom = camera.zoom;
+			float new_zoom = std::clamp(old_zoom * (io.MouseWheel > 0.0f ? 1.25f : 0.8f), MapCamera::kMinZoom, MapCamera::kMaxZoom);
+			ImVec2 cursor = { io.MousePos.x - view_pos.x, io.MousePos.y - view_pos.y };
+			camera.scroll.x = (camera.scroll.x + cursor.x) / old_zoom * new_zoom - cursor.x;
+			camera.scroll.y = (camera.scroll.y + cursor.y) / old_zoom * new_zoom - cursor.y;
+			camera.zoom = new_zoom;
 		}
+		if (ImGui::IsMouseDown(ImGuiMouseButton_Right) || ImGui::IsMouseDown(ImGuiMouseButton_Middle)) {
+			camera.scroll.x -= io.MouseDelta.x;
+			camera.scroll.y -= io.MouseDelta.y;
+		}
+	}
 
-		if (target_unit) {
-			// 射程内なら攻撃
-			int dx = std::abs(enemy.x - target_unit->x);
-			int dy = std::abs(enemy.y - target_unit->y);
-			int dist = dx + dy;
-			int min_r = enemy.min_range();
-			int max_r = enemy.max_range();
-			if (dist >= min_r && dist <= max_r) {
-				attack(enemy, *target_unit);
-				continue;
-			}
-
-
-			// 移動可能なマスを全て洗い出す
-			std::set<std::pair<int, int>> possible_moves = get_move_range(enemy);
-
-			int best_move_x = enemy.x;
-			int best_move_y = enemy.y;
-			Unit* best_attack_target = nullptr; // 移動後に攻撃するターゲット
-			int max_potential_damage = -1; // 移動後に与えられる最大ダメージ
-
-			// 移動先の候補地を評価
-			for (const auto& move_pos : possible_moves) {
-				// 移動後の位置から攻撃できる敵を探す
-				// マンハッタン距離で判定
-
-				for (auto& ally : units) {
-					if (ally.is_enemy || ally.hp <= 0) continue;
-
-					int new_dx = std::abs(move_pos.first - ally.x);
-					int new_dy = std::abs(move_pos.second - ally.y);
-					int new_dist = new_dx + new_dy;
-
-					if (new_dist >= min_r && new_dist <= max_r) {
-						// 攻撃可能なターゲットが見つかった場合
-						int current_potential_damage = std::max(0, enemy.atk - ally.def);
-						if (current_potential_damage > max_potential_damage) {
-							max_potential_damage = current_potential_damage;
-							best_move_x = move_pos.first;
-							best_move_y = move_pos.second;
-							best_attack_target = &ally; // このターゲットを攻撃する
-						}
-					}
-				}
-			}
+	// マップの外まで行き過ぎないようにする
+	float map_w = map.width() * TILE_SIZE * camera.zoom;
+	float map_h = map.height() * TILE_SIZE * camera.zoom;
+	camera.scroll.x = std::clamp(camera.scroll.x, 0.0f, std::max(0.0f, map_w - view_size.x));
+	camera.scroll.y = std::clamp(camera.scroll.y, 0.0f, std::max(0.0f, map_h - view_size.y));
+}
 
-			// 最適な移動と攻撃を実行
-			if (best_attack_target && max_potential_damage > 0) { // 攻撃可能なユニットが見つかった場合
-				enemy.x = best_move_x;
-				enemy.y = best_move_y;
-				attack(enemy, *best_attack_target);
-			} else {
-				// 攻撃可能な場所が見つからなかった場合、ターゲットに近づく
-				// ターゲットまでの距離が最も短くなる1マス移動先を探す
-				int current_dist_to_target = std::abs(enemy.x - target_unit->x) + std::abs(enemy.y - target_unit->y);
-				int best_approach_x = enemy.x;
-				int best_approach_y = enemy.y;
-
-				const int dirs[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
-
-				for (auto& dir : dirs) {
-					int nx = enemy.x + dir[0];
-					int ny = enemy.y + dir[1];
-					if (!is_within_bounds(nx, ny)) continue;
-					// 敵ユニットの移動では、他のユニットが占拠していても通過できる（隣接マスへの移動のみ）
-					// is_occupiedチェックは不要かもしれないが、ここでは残す
-					if (!is_tile_passable(nx, ny) || is_occupied(nx, ny)) continue;
-
-					int new_dist_to_target = std::abs(nx - target_unit->x) + std::abs(ny - target_unit->y);
-					if (new_dist_to_target < current_dist_to_target) {
-						current_dist_to_target = new_dist_to_target;
-						best_approach_x = nx;
-						best_approach_y = ny;
-					}
-				}
-				enemy.x = best_approach_x;
-				enemy.y = best_approach_y;
-			}
+// カーソルを合わせた敵への攻撃の予測を描画する関数
+// 選択中のユニットが攻撃できる位置(未移動なら移動範囲の全マス)ごとに予測し、反撃で倒されうるマスは赤、
+// 反撃を受けるマスは橙、反撃を受けないマスは緑で示して、ツールチップに最も安全な位置からの予測を出す
+void RenderAttackForecast(ImDrawList* draw_list, ImVec2 origin, float tile, int hover_x, int hover_y) {
+	if (battle.current_phase != PlayerTurn || !is_within_bounds(battle, hover_x, hover_y)) return;
+	if (selected_unit_index < 0 || selected_unit_index >= battle.units.size()) return;
+	const UnitTable& u = battle.units;
+	const int si = selected_unit_index;
+	if (u.hp[si] <= 0 || u.has_attacked[si]) return;
+	const int target = unit_at(battle, hover_x, hover_y);
+	if (target == NO_UNIT || !u.is_enemy[target]) return;
+
+	// 予測する位置(移動済みなら今の位置だけ)
+	CombatForecast best;
+	int best_x = -1;
+	int best_y = -1;
+	auto preview = [&](int x, int y) {
+		int occupant = unit_at(battle, x, y);
+		if (occupant != NO_UNIT && occupant != si) return;
+		CombatForecast f = forecast_attack(battle, si, target, x, y);
+		if (!f.in_range) return;
+		ImU32 color = f.death_chance > 0.0f ? IM_COL32(255, 0, 0, 110) : (f.counter ? IM_COL32(255, 160, 0, 110) : IM_COL32(0, 200, 80, 110));
+		ImVec2 tl = { origin.x + x * tile, origin.y + y * tile };
+		draw_list->AddRectFilled(tl, ImVec2(tl.x + tile, tl.y + tile), color);
+
+		// 倒される確率が低く、倒す確率が高く、反撃を受ける確率が低い位置ほどよい
+		bool better = best_x < 0 || f.death_chance < best.death_chance ||
+			(f.death_chance == best.death_chance && (f.kill_chance > best.kill_chance ||
+				(f.kill_chance == best.kill_chance && f.counter_chance < best.counter_chance)));
+		if (better) {
+			best = f;
+			best_x = x;
+			best_y = y;
 		}
+	};
+	if (u.has_moved[si]) preview(u.x[si], u.y[si]);
+	else current_move_range.for_each(preview);
+	if (best_x < 0) return;
+
+	ImGui::BeginTooltip();
+	ImGui::Text("%s -> %s (from %d, %d)", u.name(si).c_str(), u.name(target).c_str(), best_x, best_y);
+	ImGui::Text("Damage: %d  Hit: %d%%  Crit: %d%% (%d)", best.damage, std::clamp(best.hit, 0, 100), std::clamp(best.crit, 0, 100), best.crit_damage);
+	ImGui::Text("Kill: %.0f%%", best.kill_chance * 100.0f);
+	if (best.counter) {
+		ImGui::Text("Counter: %d  Hit: %d%%  Crit: %d%% (%d)", best.counter_damage, std::clamp(best.counter_hit, 0, 100), std::clamp(best.counter_crit, 0, 100), best.counter_crit_damage);
+		ImGui::Text("Counter Chance: %.0f%%  Defeated: %.0f%%", best.counter_chance * 100.0f, best.death_chance * 100.0f);
+	} else {
+		ImGui::Text("No Counter");
 	}
-	for (auto& u : units) u.has_moved = u.has_attacked = false;
-	current_phase = PlayerTurn;
+	ImGui::EndTooltip();
 }
 
 // マップとユニットを描画する関数
 void RenderMapWithUnits() {
+	ImGui::SetNextWindowSize(ImVec2(528.0f, 547.0f), ImGuiCond_FirstUseEver);
 	ImGui::Begin("Tactics Map");
+	// 表示領域の外には描かないように子ウィンドウの中に描く
+	ImGui::BeginChild("MapView", ImVec2(0.0f, 0.0f), false,
+		ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_NoMove);
 
 	ImDrawList* draw_list = ImGui::GetWindowDrawList(); // 描画リストを取得
-	ImVec2 origin = ImGui::GetCursorScreenPos();        // カーソルの位置を取得
+	ImVec2 view_pos = ImGui::GetCursorScreenPos();      // 表示領域の左上
+	ImVec2 view_size = ImGui::GetContentRegionAvail();  // 表示領域の大きさ
+	UpdateCamera(view_pos, view_size);
+
+	const TileMap& map = battle.map;
+	const float tile = TILE_SIZE * camera.zoom;
+	ImVec2 origin = { view_pos.x - camera.scroll.x, view_pos.y - camera.scroll.y }; // マップ左上の画面上の位置
+
+	// 表示領域に入っているマスだけを描く
+	TileRect visible;
+	visible.x0 = std::max(0, (int)std::floor(camera.scroll.x / tile));
+	visible.y0 = std::max(0, (int)std::floor(camera.scroll.y / tile));
+	visible.x1 = std::min(map.width(), (int)std::ceil((camera.scroll.x + view_size.x) / tile));
+	visible.y1 = std::min(map.height(), (int)std::ceil((camera.scroll.y + view_size.y) / tile));
+
+	// マップの描画(盤面か範囲の表示が変わったときだけ色を、表示範囲が変わったときだけ頂点を作り直す)
+	if (tile_batch.dirty || tile_batch.revision != battle.revision) BuildTileColors(tile_batch);
+	if (tile_batch.vertices_dirty || !(tile_batch.visible == visible) || tile_batch.zoom != camera.zoom) {
+		BuildTileVertices(tile_batch, visible, camera.zoom);
+	}
+	EmitTileBatch(draw_list, tile_batch, origin);
 
-	// マップの描画
-	for (int y = 0; y < MAP_SIZE; ++y) {
-		for (int x = 0; x < MAP_SIZE; ++x) {
-			ImU32 color = (map[y][x] == 0) ? IM_COL32(200, 200, 200, 255) : IM_COL32(100, 200, 100, 255); // 平地と森の色
-			// マスの移動可能範囲
-			if (current_move_range.count({ x, y })) color = IM_COL32(100, 100, 255, 180);
-			// マスの攻撃可能範囲
-			if (current_attack_range.count({ x, y })) color = IM_COL32(255, 100, 100, 180);
-			ImVec2 tl = { origin.x + x * TILE_SIZE, origin.y + y * TILE_SIZE };
-			ImVec2 br = { tl.x + TILE_SIZE, tl.y + TILE_SIZE };
-			draw_list->AddRectFilled(tl, br, color);
-			draw_list->AddRect(tl, br, IM_COL32(0, 0, 0, 255));
+	// ユニットの描画(表示範囲のマスにいるユニットのみ、移動中のユニットは後で補間した位置に描く)
+	auto draw_unit = [&](int i, float x, float y) {
+		ImVec2 tl = { origin.x + x * tile, origin.y + y * tile };
+		ImVec2 br = { tl.x + tile, tl.y + tile };
+		ImU32 color = battle.units.is_enemy[i] ? IM_COL32(255, 50, 50, 255) : IM_COL32(50, 50, 255, 255);
+		draw_list->AddRectFilled(tl, br, color);
+		if (i == selected_unit_index) draw_list->AddRect(tl, br, IM_COL32(255, 255, 0, 255), 0.0f, 0, 3.0f);
+	};
+	const std::vector<uint8_t>& animating = enemy_playback.animating;
+	for (int y = visible.y0; y < visible.y1; ++y) {
+		for (int x = visible.x0; x < visible.x1; ++x) {
+			int i = unit_at(battle, x, y); // HPが0のユニットはマスにいない
+			if (i == NO_UNIT || (i < (int)animating.size() && animating[i])) continue;
+			draw_unit(i, (float)x, (float)y);
 		}
 	}
+	for (const auto& anim : enemy_playback.animations) {
+		if (battle.units.hp[anim.unit] <= 0) continue;
+		float t = std::min(anim.elapsed / EnemyTurnPlayback::kMoveSeconds, 1.0f);
+		float x = anim.from_x + (anim.to_x - anim.from_x) * t;
+		float y = anim.from_y + (anim.to_y - anim.from_y) * t;
+		if (x + 1.0f < visible.x0 || y + 1.0f < visible.y0 || x > visible.x1 || y > visible.y1) continue;
+		draw_unit(anim.unit, x, y);
+	}
 
-	// ユニットの描画
-	for (size_t i = 0; i < units.size(); ++i) {
-		const auto& u = units[i];
-		if (u.hp <= 0) continue; // HPが0のユニットは描画しない
-		ImVec2 tl = { origin.x + u.x * TILE_SIZE, origin.y + u.y * TILE_SIZE };
-		ImVec2 br = { tl.x + TILE_SIZE, tl.y + TILE_SIZE };
-		ImU32 color = u.is_enemy ? IM_COL32(255, 50, 50, 255) : IM_COL32(50, 50, 255, 255);
-		draw_list->AddRectFilled(tl, br, color);
-		if ((int)i == selected_unit_index) draw_list->AddRect(tl, br, IM_COL32(255, 255, 0, 255), 0.0f, 0, 3.0f);
+	// カーソルを合わせた敵への攻撃の予測
+	ImVec2 mouse = ImGui::GetMousePos();
+	if (ImGui::IsWindowHovered()) {
+		RenderAttackForecast(draw_list, origin, tile, (int)std::floor((mouse.x - origin.x) / tile), (int)std::floor((mouse.y - origin.y) / tile));
 	}
 
 	// マスクリック処理
-	ImVec2 mouse = ImGui::GetMousePos();
 	if (ImGui::IsWindowHovered() && ImGui::IsMouseClicked(0)) {
-		int mx = (int)((mouse.x - origin.x) / TILE_SIZE);
-		int my = (int)((mouse.y - origin.y) / TILE_SIZE);
+		int mx = (int)std::floor((mouse.x - origin.x) / tile);
+		int my = (int)std::floor((mouse.y - origin.y) / tile);
 
 		// 既にユニットが選択されていて、移動範囲内なら移動処理
-		if (selected_unit_index >= 0 && selected_unit_index < (int)units.size()) {
-			auto& u = units[selected_unit_index];
-			if (u.hp > 0) {
-				if (!u.has_moved && current_move_range.count({ mx, my }) && !is_occupied(mx, my)) {
-					u.x = mx;
-					u.y = my;
-					u.has_moved = true;
+		if (selected_unit_index >= 0 && selected_unit_index < battle.units.size()) {
+			const UnitTable& u = battle.units;
+			const int si = selected_unit_index;
+			if (u.hp[si] > 0) {
+				if (!u.has_moved[si] && current_move_range.contains(mx, my) &&
+					step(battle, { ActionType::Move, si, mx, my })) {
 					current_move_range.clear();
-					current_attack_range = get_attack_range(u);
-				} else if (!u.has_attacked && current_attack_range.count({ mx, my })) {
+					get_attack_range(battle, si, current_attack_range);
+					tile_batch.dirty = true;
+				} else if (!u.has_attacked[si] && current_attack_range.contains(mx, my)) {
 					// 攻撃処理
-					for (auto& target : units) {
-						if (target.is_enemy && target.hp > 0 && target.x == mx && target.y == my) {
-							attack(u, target);
-							u.has_attacked = true;
-							break;
-						}
-					}
+					step(battle, { ActionType::Attack, si, mx, my });
 				}
 			}
 		}
 
 		// ユニット選択
-		for (size_t i = 0; i < units.size(); ++i) {
-			if (units[i].x == mx && units[i].y == my && !units[i].is_enemy && units[i].hp > 0) {
-				selected_unit_index = (int)i;
-				current_move_range = get_move_range(units[i]);
+		if (is_within_bounds(battle, mx, my)) {
+			int i = unit_at(battle, mx, my);
+			if (i != NO_UNIT && !battle.units.is_enemy[i]) {
+				selected_unit_index = i;
+				current_move_range.reset(battle.map.grid());
+				for (int tile : get_cached_move_range(battle, i)) current_move_range.set(tile);
+				tile_batch.dirty = true;
 			}
 		}
 	}
 
-	ImGui::Dummy(ImVec2(MAP_SIZE * TILE_SIZE, MAP_SIZE * TILE_SIZE));
+	ImGui::EndChild();
 	ImGui::End();
 }
 
 // ユニットパネルを描画する関数
 void RenderUnitPanel() {
 	ImGui::Begin("Unit Info");
-	if (selected_unit_index >= 0 && selected_unit_index < (int)units.size()) {
-		auto& u = units[selected_unit_index];
+	if (selected_unit_index >= 0 && selected_unit_index < battle.units.size()) {
+		const Unit u = battle.units.get(selected_unit_index);
 		if (u.hp > 0) {
 			ImGui::Text("%s", u.name.c_str());
 			ImGui::Text("Position: (%d, %d)", u.x, u.y);
 			ImGui::Text("HP: %d", u.hp);
 			ImGui::Text("ATK: %d / DEF: %d", u.atk, u.def);
+			ImGui::Text("HIT: %d%% / CRIT: %d%%", u.hit, u.crit);
 			ImGui::Text("Moved: %s", u.has_moved ? "Yes" : "No");
 			ImGui::Text("Attacked: %s", u.has_attacked ? "Yes" : "No");
+			if (show_threat_map) {
+				update_threat_map(battle, true, enemy_threat);
+				int danger = enemy_threat.max_damage_at(u.x, u.y, u.def);
+				ImGui::Text("Threat: %d enemies / Max Damage: %d", enemy_threat.count_at(u.x, u.y), std::max(danger, 0));
+			}
 		} else {
 			ImGui::Text("[Unit Is Defeted] %s", u.name.c_str());
 		}
 	} else {
 		ImGui::Text("Please Select");
 	}
-	if (current_phase == PlayerTurn && ImGui::Button("Turn End")) {
-		end_player_turn();
+	if (ImGui::Checkbox("Danger Zone", &show_threat_map)) tile_batch.dirty = true;
+	ImGui::Checkbox("MCTS AI", &use_mcts_ai);
+	if (use_mcts_ai) {
+		float think_ms = (float)mcts_config.time_budget_ms;
+		if (ImGui::SliderFloat("Think (ms)", &think_ms, 10.0f, 2000.0f, "%.0f")) mcts_config.time_budget_ms = think_ms;
+	}
+	ImGui::Checkbox("Endgame Search", &use_endgame_search);
+	if (use_endgame_search) {
+		ImGui::SliderInt("Max Units", &endgame_config.max_units, 2, 10);
+	}
+	if (battle.current_phase == PlayerTurn && ImGui::Button("Turn End")) {
+		step(battle, { ActionType::EndTurn });
+	}
+	if (ImGui::Button("Save Replay")) {
+		std::ofstream file("battle_events.bin", std::ios::binary);
+		battle_events.save(file);
+	}
+	ImGui::SameLine();
+	ImGui::Text("%d events", battle_events.event_count());
+	if (enemy_turn_job.busy()) {
+		ImGui::Text("Enemy Turn...");
+		ImGui::ProgressBar(enemy_turn_job.progress());
+	} else if (enemy_playback.active) {
+		const EnemyActionQueue& queue = enemy_playback.queue;
+		ImGui::Text("Enemy Turn");
+		ImGui::ProgressBar(queue.total() > 0 ? 1.0f - (float)queue.remaining() / (float)queue.total() : 1.0f);
 	}
 	ImGui::End();
 }
@@ -469,15 +526,68 @@ void RenderUnitPanel() {
 // 戦闘ログを描画する関数
 void RenderCombatLog() {
 	ImGui::Begin("CombatLog");
-	for (const auto& entry : combat_log) {
-		ImGui::TextWrapped("%s", entry.c_str());
+	// 文章にするのは表示するときだけ(記録は出来事の種類と数値のみ)
+	char text[256];
+	for (int i = 0; i < battle.combat_log.size(); ++i) {
+		format_combat_log(battle.combat_log[i], battle.units, text, sizeof(text));
+		ImGui::TextWrapped("%s", text);
 	}
 	ImGui::End();
 }
 
+// エネミーターンを進める関数
+// 別スレッドで全員の行動を計算し、終わったら行動を一定の間隔で盤面に適用しながら移動を補間して見せる
+void UpdateEnemyTurn(float dt) {
+	EnemyTurnPlayback& playback = enemy_playback;
+	if (!playback.active) {
+		if (!enemy_turn_job.busy()) {
+			enemy_turn_job.start(battle, use_mcts_ai ? &mcts_config : nullptr, use_endgame_search ? &endgame_config : nullptr);
+			return;
+		}
+		std::vector<EnemyPlan> plans;
+		if (!enemy_turn_job.take_plans(plans)) return;
+		playback.queue.assign(std::move(plans));
+		playback.interval = std::min(EnemyTurnPlayback::kMoveSeconds,
+			EnemyTurnPlayback::kMaxTurnSeconds / (float)std::max(playback.queue.total(), 1));
+		playback.timer = playback.interval; // 最初の行動はすぐに始める
+		playback.animations.clear();
+		playback.animating.assign(battle.units.size(), 0);
+		playback.active = true;
+	}
+
+	// 移動アニメーションを進める
+	for (auto& anim : playback.animations) anim.elapsed += dt;
+	std::erase_if(playback.animations, [&](const UnitAnimation& anim) {
+		if (anim.elapsed < EnemyTurnPlayback::kMoveSeconds) return false;
+		playback.animating[anim.unit] = 0;
+		return true;
+	});
+
+	// 間隔ごとに次の行動を適用する(遅れた分はまとめて適用するが、1フレームで使う時間には上限を設ける)
+	playback.timer += dt;
+	int due = (int)(playback.timer / playback.interval);
+	if (due > 0 && !playback.queue.empty()) {
+		int applied = playback.queue.apply_for(battle, EnemyTurnPlayback::kApplyBudgetMs, due, [&](const EnemyPlan& plan, int from_x, int from_y) {
+			int to_x = battle.units.x[plan.unit];
+			int to_y = battle.units.y[plan.unit];
+			if (to_x == from_x && to_y == from_y) return;
+			playback.animations.push_back({ plan.unit, (float)from_x, (float)from_y, (float)to_x, (float)to_y });
+			playback.animating[plan.unit] = 1;
+		});
+		playback.timer -= applied * playback.interval;
+	}
+
+	// 全員の行動とアニメーションが終わったらプレイヤーターンに戻す
+	if (playback.queue.empty() && playback.animations.empty()) {
+		end_enemy_turn(battle);
+		playback.queue.clear();
+		playback.active = false;
+	}
+}
+
 // UIを描画する関数
 void RenderUI() {
-	if (current_phase == EnemyTurn) enemy_turn_logic();
+	if (battle.current_phase == EnemyTurn) UpdateEnemyTurn(ImGui::GetIO().DeltaTime);
 	RenderMapWithUnits();
 	RenderUnitPanel();
 	RenderCombatLog();
@@ -493,6 +603,10 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
 	// ライブラリの初期化
 	Novice::Initialize(kWindowTitle, 1280, 720);
 
+	// 戦闘の出来事を記録する
+	battle.events.writer = &battle_events;
+	battle_events.begin(battle);
+
 	// キー入力結果を受け取る箱
 	char keys[256] = {0};
 	char preKeys[256] = {0};
@@ -538,6 +652,9 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
 		}
 	}
 
+	// 計算中のエネミーターンを止める
+	enemy_turn_job.cancel();
+
 	// ライブラリの終了
 	Novice::Finalize();
 	return 0;
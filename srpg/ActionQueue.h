@@ -0,0 +1,57 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 実行待ちの敵の行動の列
+/// 計算済みの計画を1フレームの時間予算の範囲で少しずつ盤面に適用し、行動の多いターンを複数フレームに分ける
+///----------------------------------------------------------------------------
+
+#include <chrono>
+#include <vector>
+
+#include "srpg/Battle.h"
+
+class EnemyActionQueue {
+public:
+	// 計画の列を入れ直す
+	void assign(std::vector<EnemyPlan> plans) {
+		plans_ = std::move(plans);
+		next_ = 0;
+	}
+	void clear() {
+		plans_.clear();
+		next_ = 0;
+	}
+
+	bool empty() const { return next_ >= plans_.size(); }
+	int remaining() const { return (int)(plans_.size() - next_); }
+	int total() const { return (int)plans_.size(); }
+
+	// 次の行動を1つ適用する
+	const EnemyPlan& apply_next(BattleState& state) {
+		const EnemyPlan& plan = plans_[next_++];
+		apply_enemy_plan(state, plan);
+		return plan;
+	}
+
+	// 最大max_count個の行動を、budget_msミリ秒を超えない範囲で適用して、適用した数を返す(1つは必ず適用する)
+	// 適用するたびにon_applied(plan, 移動前のx, 移動前のy)を呼ぶ
+	template <class Func>
+	int apply_for(BattleState& state, double budget_ms, int max_count, Func&& on_applied) {
+		using clock = std::chrono::steady_clock;
+		const auto deadline = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::milli>(budget_ms));
+		int count = 0;
+		while (count < max_count && !empty()) {
+			int unit = plans_[next_].unit;
+			int from_x = state.units.x[unit];
+			int from_y = state.units.y[unit];
+			on_applied(apply_next(state), from_x, from_y);
+			++count;
+			if (clock::now() >= deadline) break;
+		}
+		return count;
+	}
+
+private:
+	std::vector<EnemyPlan> plans_;
+	size_t next_ = 0;
+};
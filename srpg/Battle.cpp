@@ -0,0 +1,680 @@
+#include "srpg/Battle.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include "srpg/WorkerPool.h"
+
+namespace {
+
+// 初期マップの定義
+constexpr int kDefaultMapSize = 16; // マップのサイズ(16x16)
+constexpr int kDefaultMap[kDefaultMapSize][kDefaultMapSize] = {
+//   0 1 2 3 4 5 6 7 8 9.0.1.2.3.4.5
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//0
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//1
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//2
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//3
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//4
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//5
+	{0,0,0,0,0,1,0,0,0,0,1,0,0,0,0,0},//6
+	{0,0,0,0,0,1,1,0,1,0,1,0,0,0,0,0},//7
+	{0,0,0,0,0,1,0,1,0,1,1,0,0,0,0,0},//8
+	{0,0,0,0,0,1,0,0,0,0,1,0,0,0,0,0},//9
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//10
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//11
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//12
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//13
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//14
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},//15
+};
+
+// 攻撃できないときの移動先の評価の重み(影響マップの層どうしの比)
+// 相手への近さは常に優先し、影響マップは同じ近さのマスどうしを比べるときだけ使う
+// (脅威の層は攻撃力に比例して大きくなるので、近さと足し合わせると攻撃力の高い相手の近くでは後ずさりしてしまう)
+constexpr int kSupportWeight = 2;    // 味方(敵ユニット)の支援
+constexpr int kThreatWeight = 1;     // プレイヤーユニットの脅威
+constexpr int kTerrainWeight = 1;    // 地形の広さ(袋小路に入りにくくする)
+
+// ユニットにダメージを与える(倒れたら占有グリッドから外す)
+void apply_damage(BattleState& state, int unit_index, int damage) {
+	UnitTable& u = state.units;
+	bool was_alive = u.hp[unit_index] > 0;
+	u.hp[unit_index] -= damage;
+	++state.revision;
+	int x = u.x[unit_index];
+	int y = u.y[unit_index];
+	if (was_alive && u.hp[unit_index] <= 0) {
+		state.factions.remove(unit_index, u.is_enemy[unit_index] != 0);
+		stamp_unit_influence(state, unit_index, -1);
+		if (unit_at(state, x, y) == unit_index) {
+			state.occupancy[state.map.index(x, y)] = 0;
+			state.move_cache.invalidate_tile(x, y, u.is_enemy[unit_index] != 0);
+		}
+		if (state.events) state.events->on_defeated(unit_index);
+	}
+}
+
+// 攻撃できないときの移動先の、影響マップによる評価(プレイヤーの脅威、味方の支援、地形の広さ)
+// 脅威と支援の層は敵から見たものなので、プレイヤーユニットは地形の広さだけで比べる
+int influence_score(const BattleState& state, int unit_index, int x, int y) {
+	const InfluenceMap& influence = state.influence;
+	const UnitTable& units = state.units;
+	if (!units.is_enemy[unit_index]) return kTerrainWeight * influence.at(InfluenceMap::Terrain, x, y);
+	int support = influence.at(InfluenceMap::Support, x, y) - InfluenceMap::contribution(1, units.x[unit_index], units.y[unit_index], x, y); // 自分の分は除く
+	return kSupportWeight * support
+		- kThreatWeight * influence.at(InfluenceMap::Threat, x, y)
+		+ kTerrainWeight * influence.at(InfluenceMap::Terrain, x, y);
+}
+
+// 距離場を下ってユニットの移動力の分だけ進む(1歩ごとに隣の4マスを見るだけ)
+// 最短経路になる隣のマスが複数あれば影響マップの評価で選び、止まるのは最後に通った空きマス
+void follow_flow_field(const BattleState& state, const FlowField& flow, int unit_index, EnemyPlan& plan) {
+	const UnitTable& units = state.units;
+	const bool is_enemy = units.is_enemy[unit_index] != 0;
+	int x = units.x[unit_index];
+	int y = units.y[unit_index];
+	int budget = units.move[unit_index];
+	plan.move_x = x;
+	plan.move_y = y;
+
+	const int dirs[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
+	for (;;) {
+		const int d = flow.distance_at(x, y);
+		int best_x = -1;
+		int best_y = -1;
+		int best_cost = 0;
+		int best_score = std::numeric_limits<int>::min();
+		for (auto& dir : dirs) {
+			int nx = x + dir[0];
+			int ny = y + dir[1];
+			if (!is_within_bounds(state, nx, ny)) continue;
+			int cost = get_move_cost(state, unit_index, nx, ny);
+			if (cost == IMPASSABLE || cost > budget) continue;
+			// 最短経路上のマスだけ(距離0は相手のユニットのマスなので入らない)
+			int nd = flow.distance_at(nx, ny);
+			if (nd == 0 || nd == kFlowUnreachable || nd + cost != d) continue;
+			int occupant = unit_at(state, nx, ny);
+			if (occupant != NO_UNIT && units.is_enemy[occupant] != is_enemy) continue; // 敵対するユニットは通り抜けられない
+			int score = influence_score(state, unit_index, nx, ny);
+			if (score > best_score || (score == best_score && (ny < best_y || (ny == best_y && nx < best_x)))) {
+				best_score = score;
+				best_x = nx;
+				best_y = ny;
+				best_cost = cost;
+			}
+		}
+		if (best_x < 0) break;
+		budget -= best_cost;
+		x = best_x;
+		y = best_y;
+		if (!is_occupied(state, x, y)) {
+			plan.move_x = x;
+			plan.move_y = y;
+		}
+	}
+}
+
+} // namespace
+
+BattleState make_battle(TileMap map, std::vector<Unit> units) {
+	BattleState state;
+	state.map = std::move(map);
+	state.units.reserve((int)units.size());
+	for (const auto& u : units) state.units.add(u);
+	rebuild_occupancy(state);
+	return state;
+}
+
+BattleState make_default_battle() {
+	TileMap map(kDefaultMapSize, kDefaultMapSize);
+	for (int y = 0; y < kDefaultMapSize; ++y) {
+		for (int x = 0; x < kDefaultMapSize; ++x) {
+			map.set(x, y, (uint8_t)kDefaultMap[y][x]);
+		}
+	}
+
+	// ユニットの初期化
+	return make_battle(std::move(map), {
+		{"ally1", 9, 12, false, 20, 3, false, false, 7, 3, WeaponType::Sword},  // 味方ユニット
+		{"ally2", 6, 12, false, 15, 2, false, false, 5, 2, WeaponType::Bow},
+		{"enemy1", 6, 3, true, 20, 3, false, false, 7, 3, WeaponType::Sword},  // 敵ユニット
+		{"enemy2", 9, 3, true, 15, 2, false, false, 5, 2, WeaponType::Bow}
+	});
+}
+
+void rebuild_occupancy(BattleState& state) {
+	state.occupancy.assign(state.map.grid().tile_count(), 0);
+	const UnitTable& u = state.units;
+	for (int i = 0; i < u.size(); ++i) {
+		if (u.hp[i] > 0 && is_within_bounds(state, u.x[i], u.y[i])) state.occupancy[state.map.index(u.x[i], u.y[i])] = i + 1;
+	}
+	state.factions.rebuild(u, state.map.width(), state.map.height());
+	rebuild_influence(state);
+	state.move_cache.invalidate_all();
+	++state.revision;
+}
+
+int add_unit(BattleState& state, const Unit& unit) {
+	int i = state.units.add(unit);
+	if (unit.hp > 0) {
+		state.factions.insert(i, unit.x, unit.y, unit.is_enemy);
+		stamp_unit_influence(state, i, 1);
+		if (is_within_bounds(state, unit.x, unit.y)) {
+			state.occupancy[state.map.index(unit.x, unit.y)] = i + 1;
+			state.move_cache.invalidate_tile(unit.x, unit.y, unit.is_enemy);
+		}
+	}
+	++state.revision;
+	if (state.events) state.events->on_spawn(unit);
+	return i;
+}
+
+void move_unit(BattleState& state, int unit_index, int x, int y) {
+	UnitTable& u = state.units;
+	const bool is_enemy = u.is_enemy[unit_index] != 0;
+	if (unit_at(state, u.x[unit_index], u.y[unit_index]) == unit_index) {
+		state.occupancy[state.map.index(u.x[unit_index], u.y[unit_index])] = 0;
+		state.move_cache.invalidate_tile(u.x[unit_index], u.y[unit_index], is_enemy);
+	}
+	if (u.hp[unit_index] > 0) stamp_unit_influence(state, unit_index, -1);
+	u.x[unit_index] = x;
+	u.y[unit_index] = y;
+	if (u.hp[unit_index] > 0) {
+		state.occupancy[state.map.index(x, y)] = unit_index + 1;
+		state.move_cache.invalidate_tile(x, y, is_enemy);
+		state.factions.move(unit_index, x, y, is_enemy);
+		stamp_unit_influence(state, unit_index, 1);
+	}
+	++state.revision;
+	if (state.events) state.events->on_move(unit_index, x, y);
+}
+
+void set_tile(BattleState& state, int x, int y, TileType tile) {
+	state.map.set(x, y, (uint8_t)tile);
+	state.move_cache.invalidate_tile(x, y);
+	update_terrain_influence(state, x, y);
+	++state.revision;
+	if (state.events) state.events->on_tile(x, y, tile);
+}
+
+void get_attack_range(const BattleState& state, int unit_index, TileSet& out) {
+	const TileGrid& grid = state.map.grid();
+	if (out.grid() == grid) out.clear();
+	else out.reset(grid);
+	const UnitTable& u = state.units;
+	for_each_attack_tile(state, u.weapon[unit_index], u.x[unit_index], u.y[unit_index], [&](int tx, int ty) { out.insert(tx, ty); });
+}
+
+TileSet get_attack_range(const BattleState& state, int unit_index) {
+	TileSet result;
+	get_attack_range(state, unit_index, result);
+	return result;
+}
+
+namespace {
+
+// 1回の攻撃の判定結果
+struct Strike {
+	bool hit = true;
+	bool critical = false;
+	int damage = 0;
+};
+
+// hit_rollとcrit_rollで1回の攻撃を判定する
+Strike roll_strike(const UnitTable& u, int attacker_index, int target_index, uint32_t hit_roll, uint32_t crit_roll) {
+	Strike strike;
+	strike.hit = roll_percent(hit_roll, u.hit[attacker_index]);
+	if (!strike.hit) return strike;
+	strike.critical = roll_percent(crit_roll, u.crit[attacker_index]);
+	strike.damage = strike_damage(u.atk[attacker_index], u.def[target_index], strike.critical);
+	return strike;
+}
+
+// 確率(%)を0～1にする(判定と同じく0以下は0、100以上は1)
+float chance_of(int percent) {
+	return std::clamp(percent, 0, 100) / 100.0f;
+}
+
+// 1回の攻撃でhpのユニットを倒す確率
+float lethal_chance(int damage, int crit_damage, int hit, int crit, int hp) {
+	if (damage >= hp) return chance_of(hit);
+	if (crit_damage >= hp) return chance_of(hit) * chance_of(crit);
+	return 0.0f;
+}
+
+// 判定の要らない攻撃か(必ず命中し、会心が出ない)
+bool is_certain_strike(const UnitTable& u, int attacker_index) {
+	return u.hit[attacker_index] >= 100 && u.crit[attacker_index] <= 0;
+}
+
+} // namespace
+
+int strike_damage(int atk, int def, bool critical) {
+	int damage = std::max(0, atk - def);
+	return critical ? damage * CRITICAL_MULTIPLIER : damage;
+}
+
+CombatForecast forecast_attack(const BattleState& state, int attacker_index, int target_index, int from_x, int from_y) {
+	const UnitTable& u = state.units;
+	CombatForecast f;
+	const int tx = u.x[target_index];
+	const int ty = u.y[target_index];
+	f.in_range = can_attack_from(state, attacker_index, from_x, from_y, tx, ty);
+	if (!f.in_range) return f;
+
+	f.damage = strike_damage(u.atk[attacker_index], u.def[target_index], false);
+	f.crit_damage = strike_damage(u.atk[attacker_index], u.def[target_index], true);
+	f.hit = u.hit[attacker_index];
+	f.crit = u.crit[attacker_index];
+	f.kill_chance = lethal_chance(f.damage, f.crit_damage, f.hit, f.crit, u.hp[target_index]);
+
+	// 反撃は攻撃した位置に対して判定する
+	f.counter = can_attack_from(state, target_index, tx, ty, from_x, from_y);
+	if (!f.counter) return f;
+	f.counter_damage = strike_damage(u.atk[target_index], u.def[attacker_index], false);
+	f.counter_crit_damage = strike_damage(u.atk[target_index], u.def[attacker_index], true);
+	f.counter_hit = u.hit[target_index];
+	f.counter_crit = u.crit[target_index];
+	f.counter_chance = 1.0f - f.kill_chance;
+	f.death_chance = f.counter_chance * lethal_chance(f.counter_damage, f.counter_crit_damage, f.counter_hit, f.counter_crit, u.hp[attacker_index]);
+	return f;
+}
+
+void attack(BattleState& state, int attacker_index, int target_index) {
+	UnitTable& u = state.units;
+
+	// 攻撃1回(反撃を含む)でブロックを1つ使う: [0]命中 [1]会心 [2]反撃の命中 [3]反撃の会心
+	// 番号は判定が要らなくても進めるので、何番目の攻撃がどの乱数を使うかは能力値によらない
+	const uint64_t block = state.rng.counter++;
+	CombatRoll roll = {};
+	if (!is_certain_strike(u, attacker_index) || !is_certain_strike(u, target_index)) roll = state.rng.at(block);
+
+	Strike strike = roll_strike(u, attacker_index, target_index, roll.r[0], roll.r[1]);
+	if (state.events) state.events->on_strike(attacker_index, target_index, strike.damage, strike.hit, strike.critical, false);
+	if (!strike.hit) {
+		push_log(state, CombatEvent::Dodge, attacker_index, target_index);
+	}
+	else {
+		apply_damage(state, target_index, strike.damage);
+		push_log(state, strike.critical ? CombatEvent::Critical : CombatEvent::Attack, attacker_index, target_index, strike.damage);
+	}
+
+	if (u.hp[target_index] <= 0) {
+		push_log(state, CombatEvent::Defeated, target_index);
+		return;
+	}
+
+	// 反撃処理
+	if (u.hp[target_index] > 0) {
+		if (can_counter(state, target_index, attacker_index)) {
+			Strike counter = roll_strike(u, target_index, attacker_index, roll.r[2], roll.r[3]);
+			if (state.events) state.events->on_strike(target_index, attacker_index, counter.damage, counter.hit, counter.critical, true);
+			if (!counter.hit) {
+				push_log(state, CombatEvent::CounterDodge, target_index, attacker_index);
+				return;
+			}
+			apply_damage(state, attacker_index, counter.damage);
+			push_log(state, counter.critical ? CombatEvent::CriticalCounter : CombatEvent::Counter, target_index, attacker_index, counter.damage);
+			if (u.hp[attacker_index] <= 0) push_log(state, CombatEvent::Defeated, attacker_index);
+		}
+	}
+}
+
+void end_player_turn(BattleState& state) {
+	UnitTable& u = state.units;
+	for (int i = 0; i < u.size(); ++i) {
+		if (!u.is_enemy[i]) {
+			u.has_moved[i] = 0;
+			u.has_attacked[i] = 0;
+		}
+	}
+	state.current_phase = EnemyTurn;
+	if (state.events) state.events->on_phase(state);
+}
+
+EnemyPlan plan_enemy_action(const BattleState& state, int unit_index, EnemyPlanScratch& scratch, bool use_move_cache) {
+	const UnitTable& units = state.units;
+	const TileGrid& grid = state.map.grid();
+	const int ei = unit_index;
+	const int ex = units.x[ei];
+	const int ey = units.y[ei];
+
+	const bool opponent_is_enemy = !units.is_enemy[ei]; // 敵ならプレイヤーユニットを、プレイヤーユニットなら敵を狙う
+
+	EnemyPlan plan;
+	plan.unit = ei;
+	plan.move_x = ex;
+	plan.move_y = ey;
+
+	// 最も近い相手のユニットを探す
+	int target_index = state.factions.nearest(units, opponent_is_enemy, ex, ey);
+	plan.target = target_index;
+	if (target_index < 0) return plan;
+
+	const int target_x = units.x[target_index];
+	const int target_y = units.y[target_index];
+
+	// 射程内なら攻撃
+	int dx = std::abs(ex - target_x);
+	int dy = std::abs(ey - target_y);
+	int dist = dx + dy;
+	int min_r = units.min_range(ei);
+	int max_r = units.max_range(ei);
+	if (dist >= min_r && dist <= max_r) {
+		plan.attack_target = target_index;
+		return plan;
+	}
+
+	// 移動後に届きうる範囲にいる相手のユニットを集める
+	const int reach = units.move[ei] + max_r;
+	std::vector<int>& nearby = scratch.nearby;
+	nearby.clear();
+	state.factions.for_each_near(opponent_is_enemy, ex - reach, ey - reach, ex + reach, ey + reach, [&](int ai) { nearby.push_back(ai); });
+
+	// 距離場(ターンの始めに計算したもの)があり、届く範囲に誰もいなければ攻撃はできないので、
+	// 移動範囲を求めずに距離場をたどって近づく
+	const FlowField* flow = scratch.flow && scratch.flow->for_enemy != opponent_is_enemy ? scratch.flow->get(units.move_class[ei]) : nullptr;
+	if (flow && flow->distance_at(ex, ey) == kFlowUnreachable) flow = nullptr;
+	if (flow && std::none_of(nearby.begin(), nearby.end(), [&](int ai) { return std::abs(units.x[ai] - ex) + std::abs(units.y[ai] - ey) <= reach; })) {
+		plan.moves = true;
+		follow_flow_field(state, *flow, ei, plan);
+		return plan;
+	}
+
+	// 移動可能なマスを全て洗い出す
+	const std::vector<int>* possible_moves = &scratch.move.reached;
+	if (use_move_cache) possible_moves = &get_cached_move_range(state, ei);
+	else search_move_range(state, ei, scratch.move);
+
+	int best_move_x = ex;
+	int best_move_y = ey;
+	int best_attack_target = -1;   // 移動後に攻撃するターゲット
+	int max_potential_damage = -1; // 移動後に与えられる最大ダメージ
+
+	// 移動先の候補地を集める
+	TargetScoreBatch& batch = scratch.batch;
+	batch.clear();
+	for (int move_tile : *possible_moves) {
+		int move_x = grid.x_of(move_tile);
+		int move_y = grid.y_of(move_tile);
+
+		// 他のユニットがいるマスには移動できない
+		int occupant = unit_at(state, move_x, move_y);
+		if (occupant != NO_UNIT && occupant != ei) continue;
+		batch.add_tile(move_x, move_y);
+	}
+	std::sort(nearby.begin(), nearby.end()); // 同じダメージならインデックスの小さいターゲットを選ぶ
+	for (int ai : nearby) batch.add_target(units.x[ai], units.y[ai], std::max(0, units.atk[ei] - units.def[ai]), ai);
+
+	// 移動後の位置から攻撃できる敵を候補地ごとにまとめて探す(マンハッタン距離で判定)
+	score_targets(batch, min_r, max_r);
+
+	// 最もダメージの大きい候補地を選ぶ
+	// 同じダメージなら予測で反撃のダメージが小さいマス、それも同じなら行優先で先のマスを選ぶ(マスの並び順に結果が左右されないように)
+	// 反撃は相手の射程と能力値だけで比べる(hpによらないので、並列に立てた計画の前提は変わらない)
+	int best_counter = 0;
+	for (int c = 0; c < batch.tile_count(); ++c) {
+		int current_potential_damage = batch.best_damage[c];
+		if (current_potential_damage < 0 || current_potential_damage < max_potential_damage) continue;
+		int move_x = batch.tile_x[c];
+		int move_y = batch.tile_y[c];
+		const CombatForecast forecast = forecast_attack(state, ei, batch.best_target[c], move_x, move_y);
+		int counter = forecast.counter ? forecast.counter_damage : 0;
+		if (current_potential_damage > max_potential_damage || counter < best_counter ||
+			(counter == best_counter && (move_y < best_move_y || (move_y == best_move_y && move_x < best_move_x)))) {
+			max_potential_damage = current_potential_damage;
+			best_counter = counter;
+			best_move_x = move_x;
+			best_move_y = move_y;
+			best_attack_target = batch.best_target[c]; // このターゲットを攻撃する
+		}
+	}
+
+	// 最適な移動と攻撃
+	plan.moves = true;
+	if (best_attack_target >= 0 && max_potential_damage > 0) { // 攻撃可能なユニットが見つかった場合
+		plan.move_x = best_move_x;
+		plan.move_y = best_move_y;
+		plan.attack_target = best_attack_target;
+		return plan;
+	}
+
+	// 攻撃可能な場所が見つからなかった場合、移動範囲の中から相手のユニットに近づくマスを選ぶ
+	// 近さは距離場があればその移動コスト(森などを回り込んだ距離)、なければターゲットとのマンハッタン距離で測る
+	// 近さを優先し、同じ近さのマスは影響マップで比べる
+	int best_dist = std::numeric_limits<int>::max();
+	int best_score = std::numeric_limits<int>::min();
+	for (int c = 0; c < batch.tile_count(); ++c) {
+		int move_x = batch.tile_x[c];
+		int move_y = batch.tile_y[c];
+		int dist_to_target = std::abs(move_x - target_x) + std::abs(move_y - target_y);
+		if (flow) {
+			dist_to_target = flow->distance_at(move_x, move_y);
+			if (dist_to_target == kFlowUnreachable) continue;
+		}
+		if (dist_to_target > best_dist) continue;
+		int score = influence_score(state, ei, move_x, move_y);
+		if (dist_to_target < best_dist || score > best_score || (score == best_score &&
+			(move_y < plan.move_y || (move_y == plan.move_y && move_x < plan.move_x)))) {
+			best_dist = dist_to_target;
+			best_score = score;
+			plan.move_x = move_x;
+			plan.move_y = move_y;
+		}
+	}
+	return plan;
+}
+
+void apply_enemy_plan(BattleState& state, const EnemyPlan& plan) {
+	if (plan.target < 0) return;
+	if (plan.moves) move_unit(state, plan.unit, plan.move_x, plan.move_y);
+	if (plan.attack_target >= 0) attack(state, plan.unit, plan.attack_target);
+}
+
+bool is_enemy_plan_valid(const BattleState& state, const EnemyPlan& plan, MoveScratch& scratch) {
+	if (plan.target < 0) return true; // 何もしない計画
+	const UnitTable& u = state.units;
+	if (plan.unit < 0 || plan.unit >= u.size() || u.hp[plan.unit] <= 0) return false;
+
+	int x = u.x[plan.unit];
+	int y = u.y[plan.unit];
+	if (plan.moves && (plan.move_x != x || plan.move_y != y)) {
+		if (!is_within_bounds(state, plan.move_x, plan.move_y) || is_occupied(state, plan.move_x, plan.move_y)) return false;
+		search_move_range(state, plan.unit, scratch);
+		if (scratch.distance_at(plan.move_x, plan.move_y) < 0) return false;
+		x = plan.move_x;
+		y = plan.move_y;
+	}
+
+	if (plan.attack_target >= 0) {
+		const int t = plan.attack_target;
+		if (t >= u.size() || u.hp[t] <= 0 || u.is_enemy[t] == u.is_enemy[plan.unit]) return false;
+		if (!can_attack_from(state, plan.unit, x, y, u.x[t], u.y[t])) return false;
+	}
+	return true;
+}
+
+namespace {
+
+constexpr int kParallelPlanThreshold = 32; // 並列に計画を立てる敵の数の下限(少ないとスレッドの起動待ちの方が長い)
+
+// ターン中に盤面が変わったマスの印
+constexpr uint8_t kOccupancyChanged = 1; // ユニットが出入りした
+constexpr uint8_t kOpponentDefeated = 2;     // 相手のユニットが倒された
+
+// (x, y)からマンハッタン距離radius以内のマスにflagの印があるかどうか
+bool has_change_near(const BattleState& state, const std::vector<uint8_t>& changes, int x, int y, int radius, uint8_t flag) {
+	const TileGrid& grid = state.map.grid();
+	for (int dy = -radius; dy <= radius; ++dy) {
+		int ty = y + dy;
+		if (ty < 0 || ty >= grid.height) continue;
+		int span = radius - std::abs(dy);
+		for (int tx = std::max(x - span, 0); tx <= std::min(x + span, grid.width - 1); ++tx) {
+			if (changes[grid.index(tx, ty)] & flag) return true;
+		}
+	}
+	return false;
+}
+
+// 計画が読むのは、最も近い相手のユニット・移動範囲(移動力以内の占有)・移動後に届く範囲の相手のユニットと、
+// 攻撃しない場合は移動範囲の周りの影響マップなので、
+// それらに変化がなければ計画をそのまま使える
+bool is_plan_still_valid(const BattleState& state, const EnemyPlan& plan, const std::vector<uint8_t>& changes) {
+	const UnitTable& units = state.units;
+	if (plan.target < 0) return true; // 相手のユニットは増えない
+	if (units.hp[plan.target] <= 0) return false;
+
+	const int ei = plan.unit;
+	const int move = units.move[ei];
+	// 攻撃しない計画は移動範囲の周りの影響マップ(ユニットの出入りや撃破で変わる)も読んでいる
+	const int influence_radius = plan.attack_target < 0 ? move + InfluenceMap::kReach : 0;
+	if (has_change_near(state, changes, units.x[ei], units.y[ei], std::max({ move, 1, influence_radius }), kOccupancyChanged)) return false;
+	if (has_change_near(state, changes, units.x[ei], units.y[ei], std::max(move + units.max_range(ei), influence_radius), kOpponentDefeated)) return false;
+	return true;
+}
+
+// 陣営is_enemyの全員をAIで行動させる(ターンの終了はしない。最後まで行動したらtrueを返す)
+bool run_ai_turn(BattleState& state, bool is_enemy, WorkerPool& pool, EnemyTurnProgress* progress, std::vector<EnemyPlan>* committed) {
+	UnitTable& units = state.units;
+	// 行動中に倒れたユニットは一覧から外れるので、ターン開始時の一覧を写しておく
+	const std::vector<int> actors = state.factions.live(is_enemy);
+	auto cancelled = [&] { return progress && progress->cancel.load(std::memory_order_relaxed); };
+	if (progress) {
+		progress->done = 0;
+		progress->total = (int)actors.size();
+	}
+	if (committed) committed->clear();
+
+	// 相手の陣営への距離場はターンの始めに1回だけ計算し、全員で使う
+	// (ターン中に相手のユニットが倒れても作り直さないので、計画が読む状態は変わらない)
+	thread_local FlowFieldSet flow;
+	compute_flow_fields(state, is_enemy, flow);
+
+	// ターン開始時の状態に対して全員の計画を並列に立てる
+	std::vector<EnemyPlan> plans;
+	std::vector<uint8_t> changes;
+	const bool parallel = pool.size() > 1 && (int)actors.size() >= kParallelPlanThreshold;
+	if (parallel) {
+		plans.resize(actors.size());
+		std::vector<EnemyPlanScratch> scratches(pool.size());
+		for (auto& s : scratches) s.flow = &flow;
+		pool.parallel_for((int)actors.size(), [&](int k, int worker) {
+			if (!cancelled()) plans[k] = plan_enemy_action(state, actors[k], scratches[worker], false);
+		});
+		changes.assign(state.map.grid().tile_count(), 0);
+	}
+
+	// インデックス順に実行する
+	thread_local EnemyPlanScratch scratch;
+	scratch.flow = &flow;
+	for (size_t k = 0; k < actors.size(); ++k) {
+		if (cancelled()) return false;
+		if (progress) progress->done = (int)k;
+		int ei = actors[k];
+		if (units.hp[ei] <= 0) continue;
+		if (!parallel) {
+			EnemyPlan plan = plan_enemy_action(state, ei, scratch);
+			apply_enemy_plan(state, plan);
+			if (committed) committed->push_back(plan);
+			continue;
+		}
+
+		EnemyPlan plan = is_plan_still_valid(state, plans[k], changes) ? plans[k] : plan_enemy_action(state, ei, scratch);
+		const int from_x = units.x[ei];
+		const int from_y = units.y[ei];
+		apply_enemy_plan(state, plan);
+		if (committed) committed->push_back(plan);
+
+		// 後のユニットの計画の判定のために変化を記録する
+		const TileGrid& grid = state.map.grid();
+		if (units.x[ei] != from_x || units.y[ei] != from_y) {
+			changes[grid.index(from_x, from_y)] |= kOccupancyChanged;
+			changes[grid.index(units.x[ei], units.y[ei])] |= kOccupancyChanged;
+		}
+		if (units.hp[ei] <= 0) changes[grid.index(units.x[ei], units.y[ei])] |= kOccupancyChanged;
+		int defeated = plan.attack_target;
+		if (defeated >= 0 && units.hp[defeated] <= 0) {
+			changes[grid.index(units.x[defeated], units.y[defeated])] |= kOccupancyChanged | kOpponentDefeated;
+		}
+	}
+	if (cancelled()) return false;
+	if (progress) progress->done = (int)actors.size();
+	return true;
+}
+
+} // namespace
+
+void enemy_turn_logic(BattleState& state) {
+	enemy_turn_logic(state, default_worker_pool());
+}
+
+void enemy_turn_logic(BattleState& state, WorkerPool& pool, EnemyTurnProgress* progress, std::vector<EnemyPlan>* committed) {
+	if (run_ai_turn(state, true, pool, progress, committed)) end_enemy_turn(state);
+}
+
+void player_ai_turn(BattleState& state, WorkerPool& pool) {
+	if (run_ai_turn(state, false, pool, nullptr, nullptr)) end_player_turn(state);
+}
+
+void end_enemy_turn(BattleState& state) {
+	UnitTable& units = state.units;
+	std::fill(units.has_moved.begin(), units.has_moved.end(), (uint8_t)0);
+	std::fill(units.has_attacked.begin(), units.has_attacked.end(), (uint8_t)0);
+	state.current_phase = PlayerTurn;
+	++state.turn;
+	if (state.events) state.events->on_phase(state);
+}
+
+bool step(BattleState& state, const Action& action) {
+	if (state.current_phase != PlayerTurn) return false;
+
+	if (action.type == ActionType::EndTurn) {
+		end_player_turn(state);
+		return true;
+	}
+
+	if (action.unit < 0 || action.unit >= state.units.size()) return false;
+	UnitTable& u = state.units;
+	if (u.is_enemy[action.unit] || u.hp[action.unit] <= 0) return false;
+
+	switch (action.type) {
+	case ActionType::Move:
+		// 移動範囲内かつ空いているマスのみ移動できる
+		if (u.has_moved[action.unit] || !is_within_bounds(state, action.x, action.y)) return false;
+		{
+			const std::vector<int>& range = get_cached_move_range(state, action.unit);
+			int tile = state.map.index(action.x, action.y);
+			if (std::find(range.begin(), range.end(), tile) == range.end()) return false;
+		}
+		if (is_occupied(state, action.x, action.y)) return false;
+		move_unit(state, action.unit, action.x, action.y);
+		u.has_moved[action.unit] = 1;
+		if (state.events) state.events->on_acted(action.unit, true, u.has_attacked[action.unit] != 0);
+		return true;
+
+	case ActionType::Attack: {
+		// 攻撃範囲内にいる敵ユニットのみ攻撃できる
+		if (u.has_attacked[action.unit] || !is_within_bounds(state, action.x, action.y)) return false;
+		if (!can_attack_from(state, action.unit, u.x[action.unit], u.y[action.unit], action.x, action.y)) return false;
+		int target = unit_at(state, action.x, action.y);
+		if (target == NO_UNIT || !u.is_enemy[target]) return false;
+		attack(state, action.unit, target);
+		u.has_attacked[action.unit] = 1;
+		if (state.events) state.events->on_acted(action.unit, u.has_moved[action.unit] != 0, true);
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+BattleResult get_battle_result(const BattleState& state) {
+	bool ally_alive = !state.factions.live(false).empty();
+	bool enemy_alive = !state.factions.live(true).empty();
+	if (!enemy_alive) return BattleResult::PlayerWin;
+	if (!ally_alive) return BattleResult::EnemyWin;
+	return BattleResult::Ongoing;
+}
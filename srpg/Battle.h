@@ -0,0 +1,296 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// SRPGのシミュレーションコア
+/// Novice/DirectX/ImGuiに依存しないので、Linuxのバッチ環境でもそのまま動かせる
+///----------------------------------------------------------------------------
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "srpg/BattleEvents.h"
+#include "srpg/CombatLog.h"
+#include "srpg/CombatRng.h"
+#include "srpg/FactionIndex.h"
+#include "srpg/FlowField.h"
+#include "srpg/InfluenceMap.h"
+#include "srpg/MoveRange.h"
+#include "srpg/TargetScore.h"
+#include "srpg/TileMap.h"
+#include "srpg/Unit.h"
+#include "srpg/Weapon.h"
+
+// ------------------------
+// マップとユニット情報
+// ------------------------
+constexpr int CRITICAL_MULTIPLIER = 3; // 会心の一撃のダメージ倍率
+
+// 地形ごとの移動コスト表(値は1～MAX_MOVE_COSTかIMPASSABLE)
+struct MoveCostTable {
+	uint8_t cost[(int)MoveClass::Count][TILE_TYPE_COUNT] = {};
+
+	uint8_t at(MoveClass move_class, int tile) const {
+		return cost[(int)move_class][tile];
+	}
+
+	// すべての値が1～MAX_MOVE_COSTかIMPASSABLEか
+	// (移動範囲と距離場のバケットキューはこれを前提にしているので、表を書き換えたら確かめること)
+	constexpr bool valid() const {
+		for (const auto& row : cost) {
+			for (uint8_t c : row) {
+				if (c != IMPASSABLE && (c < 1 || c > MAX_MOVE_COST)) return false;
+			}
+		}
+		return true;
+	}
+};
+
+// 標準の移動コスト表(地形ごとの基本コストに移動タイプごとの上書きを適用したもの)
+constexpr MoveCostTable make_default_move_costs() {
+	// 地形ごとの基本コスト
+	constexpr uint8_t base[TILE_TYPE_COUNT] = {
+		1,          // PLAIN
+		IMPASSABLE, // FOREST: 森を通れない
+		2,          // HILL
+		IMPASSABLE  // WATER
+	};
+
+	MoveCostTable table;
+	for (int c = 0; c < (int)MoveClass::Count; ++c) {
+		for (int t = 0; t < TILE_TYPE_COUNT; ++t) table.cost[c][t] = base[t];
+	}
+
+	// 移動タイプごとの上書き
+	table.cost[(int)MoveClass::Cavalry][HILL] = 3; // 騎兵は丘が苦手
+	for (int t = 0; t < TILE_TYPE_COUNT; ++t) {
+		table.cost[(int)MoveClass::Flying][t] = 1; // 飛行はどの地形も1
+	}
+	return table;
+}
+static_assert(make_default_move_costs().valid());
+
+// ターンのフェーズ
+enum Phase : int {
+	PlayerTurn, // プレイヤーターン
+	EnemyTurn   // エネミーターン
+};
+
+// 占有グリッドの空きマス
+constexpr int NO_UNIT = -1;
+
+// 戦闘の状態(コピーすればそのまま別の戦闘として進められる値型)
+// unitsの位置やhpを直接書き換えた場合はrebuild_occupancyを、move_costsを書き換えた場合は値をMoveCostTable::validで確かめてから、move_cache.invalidate_allとrebuild_influenceを呼ぶこと
+struct BattleState {
+	TileMap map;                         // マップ(TileType)
+	MoveCostTable move_costs = make_default_move_costs(); // 地形ごとの移動コスト
+	std::vector<int> occupancy;          // マスにいる生存ユニットのインデックス+1(0なら空き、マス番号順)
+	UnitTable units;                     // 全ユニット(フィールドごとの配列)
+	FactionIndex factions;               // 陣営ごとの生存ユニットと空間インデックス
+	InfluenceMap influence;              // 影響マップ(ユニットの移動や撃破のたびに差分で更新する)
+	Phase current_phase = PlayerTurn;    // 現在のフェーズ(開始時はプレイヤーターン)
+	int turn = 1;                        // 現在のターン数
+	uint64_t revision = 0;               // 盤面(位置・hp・地形)が変わるたびに増える番号(派生データのキャッシュ判定用)
+	CombatLog combat_log;                // 戦闘ログ(新しい順、文章にするのは表示するとき)
+	CombatRng rng;                       // 命中と会心の判定に使う乱数(攻撃1回ごとに1ブロック引く)
+	BattleEventTap events;               // 出来事の記録先(なければ記録しない。盤面をコピーしても写しには引き継がない)
+
+	mutable MoveRangeCache move_cache;   // ユニットごとの移動範囲のキャッシュ(同じ状態を複数スレッドから同時に読む場合は使わないこと)
+};
+
+// 戦闘の勝敗
+enum class BattleResult {
+	Ongoing,   // 続行中
+	PlayerWin, // プレイヤーの勝利
+	EnemyWin   // エネミーの勝利
+};
+
+// プレイヤーの行動の種類
+enum class ActionType {
+	Move,   // 移動
+	Attack, // 攻撃
+	EndTurn // ターン終了
+};
+
+// 敵1体の行動計画
+struct EnemyPlan {
+	int unit = -1;          // 行動する敵のインデックス
+	int target = -1;        // 最も近いプレイヤーユニット(いなければ-1で、何もしない)
+	bool moves = false;     // 移動するかどうか
+	int move_x = 0;         // 移動先
+	int move_y = 0;
+	int attack_target = -1; // 攻撃する相手(攻撃しなければ-1)
+};
+
+// 攻撃の予測(attackを呼ばずに見積もった結果)
+// 確率は命中率・会心率どおりの値(attackの判定と同じ分布)
+struct CombatForecast {
+	bool in_range = false;         // その位置から攻撃が届くか(falseなら他の値は0)
+	int damage = 0;                // 命中したときのダメージ
+	int crit_damage = 0;           // 会心の一撃のダメージ
+	int hit = 0;                   // 命中率(%)
+	int crit = 0;                  // 会心率(%)
+	bool counter = false;          // 相手が倒れなければ反撃が届くか
+	int counter_damage = 0;        // 反撃が命中したときのダメージ
+	int counter_crit_damage = 0;   // 反撃の会心の一撃のダメージ
+	int counter_hit = 0;           // 反撃の命中率(%)
+	int counter_crit = 0;          // 反撃の会心率(%)
+	float kill_chance = 0.0f;      // 相手を倒す確率
+	float counter_chance = 0.0f;   // 反撃を受ける確率
+	float death_chance = 0.0f;     // 反撃で倒される確率
+};
+
+// 行動計画の作業領域(スレッドごとに1つ用意する)
+struct EnemyPlanScratch {
+	MoveScratch move;
+	TargetScoreBatch batch;
+	std::vector<int> nearby;
+	const FlowFieldSet* flow = nullptr; // 相手の陣営への距離場(なければ移動範囲の中でターゲットとのマンハッタン距離で近づく)
+};
+
+// エネミーターンの進み具合(別スレッドから読み書きする)
+struct EnemyTurnProgress {
+	std::atomic<int> done{ 0 };         // 行動を終えた敵の数
+	std::atomic<int> total{ 0 };        // ターン開始時の敵の数
+	std::atomic<bool> cancel{ false };  // 立てると残りの敵は行動せずに戻る
+};
+
+class WorkerPool;
+
+// プレイヤーの行動
+struct Action {
+	ActionType type = ActionType::EndTurn;
+	int unit = -1; // 行動するユニットのインデックス
+	int x = 0;     // 移動先/攻撃先のマス
+	int y = 0;
+};
+
+// ------------------------
+// ルール関数
+// ------------------------
+
+// マップとユニットから戦闘を作成する関数
+BattleState make_battle(TileMap map, std::vector<Unit> units);
+
+// 初期配置の戦闘を作成する関数
+BattleState make_default_battle();
+
+// マップの範囲内かどうかを判定する関数
+inline bool is_within_bounds(const BattleState& state, int x, int y) {
+	return state.map.contains(x, y);
+}
+
+// ユニットがタイルに進入するときの移動コストを返す関数(進入できなければIMPASSABLE)
+inline uint8_t get_move_cost(const BattleState& state, int unit_index, int x, int y) {
+	return state.move_costs.at(state.units.move_class[unit_index], state.map.at(x, y));
+}
+
+// タイルが進行可能かどうかを判定する関数
+inline bool is_tile_passable(const BattleState& state, int unit_index, int x, int y) {
+	return get_move_cost(state, unit_index, x, y) != IMPASSABLE;
+}
+
+// 占有グリッドと陣営のインデックスをunitsから作り直す関数
+void rebuild_occupancy(BattleState& state);
+
+// ユニットを戦闘に追加する関数(インデックスを返す)
+int add_unit(BattleState& state, const Unit& unit);
+
+// 指定したマスにいる生存ユニットのインデックスを返す関数(いなければNO_UNIT)
+inline int unit_at(const BattleState& state, int x, int y) {
+	return state.occupancy[state.map.index(x, y)] - 1;
+}
+
+// ユニットがその位置にいるかどうかを判定する関数
+inline bool is_occupied(const BattleState& state, int x, int y) {
+	return state.occupancy[state.map.index(x, y)] != 0;
+}
+
+// ユニットを移動させる関数(占有グリッドと移動範囲のキャッシュも更新する)
+void move_unit(BattleState& state, int unit_index, int x, int y);
+
+// マスの地形を変更する関数(移動範囲のキャッシュも更新する)
+void set_tile(BattleState& state, int x, int y, TileType tile);
+
+// ユニットが(from_x, from_y)から(x, y)のマスを攻撃できるかどうかを判定する関数(O(1))
+inline bool can_attack_from(const BattleState& state, int unit_index, int from_x, int from_y, int x, int y) {
+	return in_weapon_range(state.units.weapon[unit_index], x - from_x, y - from_y);
+}
+
+// 攻撃されたユニットがその場から反撃できるかどうかを判定する関数(O(1))
+inline bool can_counter(const BattleState& state, int target_index, int attacker_index) {
+	const UnitTable& u = state.units;
+	return can_attack_from(state, target_index, u.x[target_index], u.y[target_index], u.x[attacker_index], u.y[attacker_index]);
+}
+
+// (x, y)から武器で攻撃できるマップ内のマスを列挙する関数(ステンシルを使うのでヒープ確保をしない)
+template <class Func>
+void for_each_attack_tile(const BattleState& state, WeaponType weapon, int x, int y, Func&& func) {
+	const AttackStencil& stencil = get_attack_stencil(weapon);
+	for (int k = 0; k < stencil.count; ++k) {
+		int tx = x + stencil.dx[k];
+		int ty = y + stencil.dy[k];
+		if (is_within_bounds(state, tx, ty)) func(tx, ty);
+	}
+}
+
+// ユニットの攻撃範囲を計算する関数(outの領域を使い回す)
+void get_attack_range(const BattleState& state, int unit_index, TileSet& out);
+
+// ユニットの攻撃範囲を計算する関数
+TileSet get_attack_range(const BattleState& state, int unit_index);
+
+// 戦闘ログに追加する関数
+inline void push_log(BattleState& state, CombatEvent type, int actor, int target = -1, int value = 0) {
+	state.combat_log.push({ type, actor, target, value });
+}
+
+// 攻撃力atkの攻撃が防御力defのユニットに命中したときのダメージ(criticalなら会心の一撃)
+// attack・forecast_attack・脅威マップはすべてこれでダメージを計算する
+int strike_damage(int atk, int def, bool critical);
+
+// (from_x, from_y)に移動してから攻撃した場合の結果を予測する関数(状態は変えない)
+// ヒープ確保も乱数もなくO(1)なので、移動範囲の全マスについて毎フレーム呼んでもよい
+CombatForecast forecast_attack(const BattleState& state, int attacker_index, int target_index, int from_x, int from_y);
+
+// ユニットを攻撃する関数(反撃も含む)
+// 命中と会心はstate.rngから1ブロック引いて判定する(命中率100%・会心率0%同士なら乱数によらず atk - def のダメージ)
+void attack(BattleState& state, int attacker_index, int target_index);
+
+// プレイヤーターンを終了する関数
+void end_player_turn(BattleState& state);
+
+// 敵1体の行動を決める関数(状態は変えない)
+// プレイヤーユニットを渡すと、敵を相手に同じ考え方で行動を決める(AI同士の対戦用)
+// use_move_cacheがfalseなら移動範囲のキャッシュを使わないので、同じ状態に対して複数スレッドから同時に呼べる
+EnemyPlan plan_enemy_action(const BattleState& state, int unit_index, EnemyPlanScratch& scratch, bool use_move_cache = true);
+
+// 敵1体の行動計画を実行する関数
+void apply_enemy_plan(BattleState& state, const EnemyPlan& plan);
+
+// 行動計画が今の盤面でもそのまま実行できるかを調べる関数
+// (ユニットと攻撃相手が生きている、移動先が空いていて移動範囲内、移動先から攻撃が届く)
+// 別の盤面で立てた計画を使い回す前に呼ぶ(apply_enemy_planはこれを確かめない)
+bool is_enemy_plan_valid(const BattleState& state, const EnemyPlan& plan, MoveScratch& scratch);
+
+// エネミーターンのロジック
+// 敵が多いときは、ターン開始時の状態に対して全員の計画をワーカープールで並列に立ててから、インデックス順に実行する
+// 先に行動した敵の結果が計画の前提(周囲のマスの占有や、プレイヤーユニットの撃破)を変えていたらその場で立て直すので、
+// 結果はスレッド数によらず1体ずつ順に決めた場合と一致する
+// progressを渡すと進み具合を書き込み、cancelが立ったらその時点で戻る(状態はターンの途中のまま、フェーズもEnemyTurnのまま)
+// committedを渡すと実行した計画を順に記録する(ターン開始時の状態に順にapply_enemy_planすれば同じ結果を再現できる)
+void enemy_turn_logic(BattleState& state);
+void enemy_turn_logic(BattleState& state, WorkerPool& pool, EnemyTurnProgress* progress = nullptr,
+	std::vector<EnemyPlan>* committed = nullptr);
+
+// プレイヤーターンをエネミーターンと同じAIで進めて終了する関数(AI同士の対戦用)
+void player_ai_turn(BattleState& state, WorkerPool& pool);
+
+// エネミーターンを終了する関数(行動済みフラグを戻してプレイヤーターンにする)
+void end_enemy_turn(BattleState& state);
+
+// プレイヤーの行動を1つ適用する関数(不正な行動ならfalseを返し、状態は変えない)
+bool step(BattleState& state, const Action& action);
+
+// 勝敗を判定する関数
+BattleResult get_battle_result(const BattleState& state);
@@ -0,0 +1,436 @@
+#include "srpg/BattleEvents.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "srpg/Battle.h"
+
+namespace {
+
+constexpr uint8_t kMagic[8] = { 'S', 'R', 'P', 'G', 'E', 'V', 'T', '1' };
+
+// 行動済みフラグのビット
+constexpr uint8_t kMovedBit = 1;
+constexpr uint8_t kAttackedBit = 2;
+
+// 攻撃の結果のビット
+constexpr uint8_t kHitBit = 1;
+constexpr uint8_t kCriticalBit = 2;
+constexpr uint8_t kCounterBit = 4;
+
+// ------------------------
+// 可変長整数
+// ------------------------
+
+void put_uint(std::vector<uint8_t>& out, uint64_t v) {
+	while (v >= 0x80) {
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+void put_int(std::vector<uint8_t>& out, int64_t v) {
+	put_uint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+// 読み出し(範囲外を読もうとしたらokをfalseにして0を返す)
+struct Reader {
+	const uint8_t* p;
+	const uint8_t* end;
+	bool ok = true;
+
+	uint64_t get_uint() {
+		uint64_t v = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (p >= end) break;
+			uint8_t b = *p++;
+			v |= (uint64_t)(b & 0x7F) << shift;
+			if (!(b & 0x80)) return v;
+		}
+		ok = false;
+		return 0;
+	}
+	int64_t get_int() {
+		uint64_t v = get_uint();
+		return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+	}
+	int get_i32() { return (int)get_int(); }
+	std::string get_string() {
+		uint64_t n = get_uint();
+		if (!ok || n > (uint64_t)(end - p)) {
+			ok = false;
+			return std::string();
+		}
+		std::string s((const char*)p, (size_t)n);
+		p += n;
+		return s;
+	}
+	bool get_bytes(uint8_t* out, size_t n) {
+		if (!ok || n > (size_t)(end - p)) {
+			ok = false;
+			return false;
+		}
+		std::memcpy(out, p, n);
+		p += n;
+		return true;
+	}
+};
+
+// ------------------------
+// 盤面全体(記録開始時とスナップショット)
+// ------------------------
+
+void put_unit(std::vector<uint8_t>& out, const Unit& u) {
+	put_uint(out, u.name.size());
+	out.insert(out.end(), u.name.begin(), u.name.end());
+	put_int(out, u.x);
+	put_int(out, u.y);
+	put_uint(out, u.is_enemy ? 1 : 0);
+	put_int(out, u.hp);
+	put_int(out, u.move);
+	put_int(out, u.atk);
+	put_int(out, u.def);
+	put_uint(out, (uint64_t)u.weapon);
+	put_uint(out, (uint64_t)u.move_class);
+	put_int(out, u.hit);
+	put_int(out, u.crit);
+	put_uint(out, (u.has_moved ? kMovedBit : 0) | (u.has_attacked ? kAttackedBit : 0));
+}
+
+bool get_unit(Reader& r, Unit& u) {
+	u.name = r.get_string();
+	u.x = r.get_i32();
+	u.y = r.get_i32();
+	u.is_enemy = r.get_uint() != 0;
+	u.hp = r.get_i32();
+	u.move = r.get_i32();
+	u.atk = r.get_i32();
+	u.def = r.get_i32();
+	uint64_t weapon = r.get_uint();
+	uint64_t move_class = r.get_uint();
+	u.hit = r.get_i32();
+	u.crit = r.get_i32();
+	uint64_t flags = r.get_uint();
+	if (!r.ok || weapon >= (uint64_t)WeaponType::Count || move_class >= (uint64_t)MoveClass::Count) return false;
+	u.weapon = (WeaponType)weapon;
+	u.move_class = (MoveClass)move_class;
+	u.has_moved = (flags & kMovedBit) != 0;
+	u.has_attacked = (flags & kAttackedBit) != 0;
+	return true;
+}
+
+// 先頭はターンとフェーズ(位置を調べるときはそこだけ読む)
+void put_state(std::vector<uint8_t>& out, const BattleState& state) {
+	put_int(out, state.turn);
+	put_uint(out, (uint64_t)state.current_phase);
+	put_uint(out, state.rng.key);
+	put_uint(out, state.rng.counter);
+
+	const TileMap& map = state.map;
+	put_uint(out, (uint64_t)map.width());
+	put_uint(out, (uint64_t)map.height());
+	put_uint(out, (uint64_t)map.grid().layout);
+	for (int y = 0; y < map.height(); ++y) {
+		for (int x = 0; x < map.width(); ++x) out.push_back(map.at(x, y));
+	}
+
+	put_uint(out, (uint64_t)state.units.size());
+	for (int i = 0; i < state.units.size(); ++i) put_unit(out, state.units.get(i));
+}
+
+bool get_state(Reader& r, BattleState& out) {
+	int turn = r.get_i32();
+	uint64_t phase = r.get_uint();
+	CombatRng rng;
+	rng.key = r.get_uint();
+	rng.counter = r.get_uint();
+
+	uint64_t width = r.get_uint();
+	uint64_t height = r.get_uint();
+	uint64_t layout = r.get_uint();
+	if (!r.ok || phase > EnemyTurn || layout > (uint64_t)TileLayout::Blocked) return false;
+	const uint64_t remaining = (uint64_t)(r.end - r.p);
+	if (width == 0 || height == 0 || width > remaining || height > remaining || width * height > remaining) return false;
+	TileMap map((int)width, (int)height, (TileLayout)layout);
+	std::vector<uint8_t> tiles((size_t)(width * height));
+	if (!r.get_bytes(tiles.data(), tiles.size())) return false;
+	if (std::any_of(tiles.begin(), tiles.end(), [](uint8_t t) { return t >= TILE_TYPE_COUNT; })) return false;
+	for (int y = 0; y < map.height(); ++y) {
+		for (int x = 0; x < map.width(); ++x) map.set(x, y, tiles[(size_t)y * width + x]);
+	}
+
+	uint64_t count = r.get_uint();
+	if (!r.ok || count > (uint64_t)(r.end - r.p)) return false;
+	std::vector<Unit> units((size_t)count);
+	for (Unit& u : units) {
+		if (!get_unit(r, u) || !map.contains(u.x, u.y)) return false;
+	}
+
+	out = make_battle(std::move(map), std::move(units));
+	out.turn = turn;
+	out.current_phase = (Phase)phase;
+	out.rng = rng;
+	return true;
+}
+
+// フェーズの順番(ターンが進むと増える)
+int phase_order(int turn, int phase) {
+	return turn * 2 + phase;
+}
+
+} // namespace
+
+// ------------------------
+// 書き手
+// ------------------------
+
+BattleEventWriter::BattleEventWriter(int snapshot_interval)
+	: snapshot_interval_(std::max(snapshot_interval, 1)) {
+}
+
+void BattleEventWriter::finish(BattleEventType type) {
+	bytes_.push_back((uint8_t)type);
+	put_uint(bytes_, payload_.size());
+	bytes_.insert(bytes_.end(), payload_.begin(), payload_.end());
+	++event_count_;
+}
+
+void BattleEventWriter::begin(const BattleState& state) {
+	bytes_.assign(std::begin(kMagic), std::end(kMagic));
+	event_count_ = 0;
+	payload_.clear();
+	put_state(payload_, state);
+	finish(BattleEventType::Begin);
+}
+
+void BattleEventWriter::snapshot(const BattleState& state) {
+	payload_.clear();
+	put_state(payload_, state);
+	finish(BattleEventType::Snapshot);
+}
+
+void BattleEventWriter::on_move(int unit, int x, int y) {
+	payload_.clear();
+	put_uint(payload_, (uint64_t)unit);
+	put_int(payload_, x);
+	put_int(payload_, y);
+	finish(BattleEventType::Move);
+}
+
+void BattleEventWriter::on_strike(int attacker, int target, int damage, bool hit, bool critical, bool counter) {
+	payload_.clear();
+	put_uint(payload_, (uint64_t)attacker);
+	put_uint(payload_, (uint64_t)target);
+	put_int(payload_, damage);
+	put_uint(payload_, (hit ? kHitBit : 0) | (critical ? kCriticalBit : 0) | (counter ? kCounterBit : 0));
+	finish(BattleEventType::Strike);
+}
+
+void BattleEventWriter::on_defeated(int unit) {
+	payload_.clear();
+	put_uint(payload_, (uint64_t)unit);
+	finish(BattleEventType::Defeated);
+}
+
+void BattleEventWriter::on_acted(int unit, bool moved, bool attacked) {
+	payload_.clear();
+	put_uint(payload_, (uint64_t)unit);
+	put_uint(payload_, (moved ? kMovedBit : 0) | (attacked ? kAttackedBit : 0));
+	finish(BattleEventType::Acted);
+}
+
+void BattleEventWriter::on_phase(const BattleState& state) {
+	payload_.clear();
+	put_int(payload_, state.turn);
+	put_uint(payload_, (uint64_t)state.current_phase);
+	finish(BattleEventType::Phase);
+	if (state.current_phase == PlayerTurn && state.turn % snapshot_interval_ == 0) snapshot(state);
+}
+
+void BattleEventWriter::on_tile(int x, int y, int tile) {
+	payload_.clear();
+	put_int(payload_, x);
+	put_int(payload_, y);
+	put_uint(payload_, (uint64_t)tile);
+	finish(BattleEventType::Tile);
+}
+
+void BattleEventWriter::on_spawn(const Unit& unit) {
+	payload_.clear();
+	put_unit(payload_, unit);
+	finish(BattleEventType::Spawn);
+}
+
+bool BattleEventWriter::save(std::ostream& out) const {
+	out.write((const char*)bytes_.data(), (std::streamsize)bytes_.size());
+	return (bool)out;
+}
+
+// ------------------------
+// 再生
+// ------------------------
+
+bool BattleReplay::load(std::vector<uint8_t> bytes, std::string& error) {
+	bytes_ = std::move(bytes);
+	snapshots_.clear();
+	if (bytes_.size() < sizeof(kMagic) || std::memcmp(bytes_.data(), kMagic, sizeof(kMagic)) != 0) {
+		error = "not a battle event stream";
+		return false;
+	}
+
+	// 件の区切りを確かめながら、スナップショットの位置とターンの範囲を調べる
+	Reader r{ bytes_.data() + sizeof(kMagic), bytes_.data() + bytes_.size() };
+	while (r.p < r.end) {
+		const size_t offset = (size_t)(r.p - bytes_.data());
+		BattleEventType type = (BattleEventType)*r.p++;
+		uint64_t length = r.get_uint();
+		if (!r.ok || length > (uint64_t)(r.end - r.p)) {
+			error = "truncated event at offset " + std::to_string(offset);
+			return false;
+		}
+		Reader payload{ r.p, r.p + length };
+		r.p += length;
+
+		if (snapshots_.empty() && type != BattleEventType::Begin) {
+			error = "stream does not start with a begin event";
+			return false;
+		}
+		if (type == BattleEventType::Begin || type == BattleEventType::Snapshot || type == BattleEventType::Phase) {
+			int turn = payload.get_i32();
+			int phase = (int)payload.get_uint();
+			if (!payload.ok) {
+				error = "corrupt event at offset " + std::to_string(offset);
+				return false;
+			}
+			if (type != BattleEventType::Phase) snapshots_.push_back({ offset, turn, phase });
+			if (type == BattleEventType::Begin) first_turn_ = turn;
+			last_turn_ = std::max(last_turn_, turn);
+		}
+	}
+	if (snapshots_.empty()) {
+		error = "empty stream";
+		return false;
+	}
+	return true;
+}
+
+bool BattleReplay::load(std::istream& in, std::string& error) {
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	return load(std::move(bytes), error);
+}
+
+bool BattleReplay::seek(int turn, Phase phase, BattleState& out) const {
+	// 目的のフェーズ以前で最も新しいスナップショットから始める
+	const int target = phase_order(turn, phase);
+	const SnapshotInfo* start = nullptr;
+	for (const SnapshotInfo& s : snapshots_) {
+		if (phase_order(s.turn, s.phase) <= target) start = &s;
+	}
+	if (!start) return false;
+	return replay(start->offset, turn, phase, out);
+}
+
+bool BattleReplay::seek_end(BattleState& out) const {
+	if (snapshots_.empty()) return false;
+	return replay(snapshots_.back().offset, -1, -1, out);
+}
+
+bool BattleReplay::replay(size_t from, int stop_turn, int stop_phase, BattleState& out) const {
+	Reader r{ bytes_.data() + from, bytes_.data() + bytes_.size() };
+	const bool until_end = stop_turn < 0;
+	BattleState state;
+	bool started = false;
+	bool reached = false;
+
+	while (r.p < r.end && !reached) {
+		BattleEventType type = (BattleEventType)*r.p++;
+		uint64_t length = r.get_uint();
+		Reader e{ r.p, r.p + length };
+		r.p += length;
+
+		UnitTable& u = state.units;
+		auto valid_unit = [&](uint64_t i) { return i < (uint64_t)u.size(); };
+		switch (type) {
+		case BattleEventType::Begin:
+		case BattleEventType::Snapshot:
+			// 始めの1件だけ読む(途中のスナップショットは出来事から作った盤面と同じなので読み飛ばす)
+			if (!started) {
+				if (!get_state(e, state)) return false;
+				started = true;
+			}
+			break;
+		case BattleEventType::Move: {
+			uint64_t i = e.get_uint();
+			int x = e.get_i32();
+			int y = e.get_i32();
+			if (!e.ok || !valid_unit(i) || !state.map.contains(x, y)) return false;
+			u.x[i] = x;
+			u.y[i] = y;
+			break;
+		}
+		case BattleEventType::Strike: {
+			e.get_uint(); // 攻撃した側(hpは変わらない)
+			uint64_t target = e.get_uint();
+			int damage = e.get_i32();
+			uint64_t flags = e.get_uint();
+			if (!e.ok || !valid_unit(target)) return false;
+			if (flags & kHitBit) u.hp[target] -= damage;
+			// attackは攻撃と反撃の1回のやりとりごとに乱数を1ブロック引く
+			if (!(flags & kCounterBit)) ++state.rng.counter;
+			break;
+		}
+		case BattleEventType::Defeated:
+			break; // hpの変化で分かる
+		case BattleEventType::Acted: {
+			uint64_t i = e.get_uint();
+			uint64_t flags = e.get_uint();
+			if (!e.ok || !valid_unit(i)) return false;
+			u.has_moved[i] = (flags & kMovedBit) ? 1 : 0;
+			u.has_attacked[i] = (flags & kAttackedBit) ? 1 : 0;
+			break;
+		}
+		case BattleEventType::Phase: {
+			int turn = e.get_i32();
+			uint64_t phase = e.get_uint();
+			if (!e.ok || phase > EnemyTurn) return false;
+			// end_player_turnはプレイヤーユニットの、end_enemy_turnは全員の行動済みフラグを戻す
+			for (int i = 0; i < u.size(); ++i) {
+				if (phase == PlayerTurn || !u.is_enemy[i]) {
+					u.has_moved[i] = 0;
+					u.has_attacked[i] = 0;
+				}
+			}
+			state.turn = turn;
+			state.current_phase = (Phase)phase;
+			break;
+		}
+		case BattleEventType::Tile: {
+			int x = e.get_i32();
+			int y = e.get_i32();
+			uint64_t tile = e.get_uint();
+			if (!e.ok || !state.map.contains(x, y) || tile >= TILE_TYPE_COUNT) return false;
+			state.map.set(x, y, (uint8_t)tile);
+			break;
+		}
+		case BattleEventType::Spawn: {
+			Unit unit;
+			if (!get_unit(e, unit) || !state.map.contains(unit.x, unit.y)) return false;
+			u.add(unit);
+			break;
+		}
+		default:
+			break; // 知らない種類は読み飛ばす
+		}
+		if (!started) return false;
+		if (!until_end && state.turn == stop_turn && (int)state.current_phase == stop_phase) reached = true;
+	}
+	if (!until_end && !reached) return false;
+
+	// 出来事は配列に直接適用したので、占有や空間インデックスなどの派生データを作り直す
+	rebuild_occupancy(state);
+	out = std::move(state);
+	return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 戦闘の出来事のバイナリ記録と再生
+/// 盤面を変える出来事(移動、攻撃と反撃、撃破、フェーズの交代、地形の変更、ユニットの追加)を
+/// 追記のみのバイト列に1件ずつ書き、数ターンごとに盤面のスナップショットを挟む
+/// 再生では指定したターンの直前のスナップショットから出来事を適用し直すので、長い戦闘でもすぐに目的のターンを作れる
+/// スナップショットには乱数の状態も入るので、復元した盤面からAIを動かせば記録時と同じ行動を再現できる
+///
+/// 1件の書式: [種類 1バイト][内容の長さ 可変長整数][内容]
+/// 整数はすべて可変長整数(LEB128、符号付きはZigZag)で書く
+///----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BattleState;
+struct Unit;
+enum Phase : int;
+
+// 出来事の種類
+enum class BattleEventType : uint8_t {
+	Begin = 1, // 記録開始時の盤面(マップとユニットの全情報)
+	Snapshot,  // その時点の盤面(地形とユニットの位置・hp・行動済みフラグ、フェーズ、ターン、乱数)
+	Move,      // ユニットの移動
+	Strike,    // 攻撃または反撃(外れも記録する)
+	Defeated,  // ユニットが倒れた
+	Acted,     // 行動済みフラグの変更
+	Phase,     // フェーズの交代(行動済みフラグはend_player_turn/end_enemy_turnと同じ規則で戻す)
+	Tile,      // 地形の変更
+	Spawn      // ユニットの追加
+};
+
+// 戦闘の出来事の書き手(追記のみ)
+class BattleEventWriter {
+public:
+	// snapshot_interval: スナップショットを挟むターンの間隔(1以上)
+	explicit BattleEventWriter(int snapshot_interval = 5);
+
+	// 記録を始める(それまでの記録は捨てる)
+	void begin(const BattleState& state);
+
+	void on_move(int unit, int x, int y);
+	void on_strike(int attacker, int target, int damage, bool hit, bool critical, bool counter);
+	void on_defeated(int unit);
+	void on_acted(int unit, bool moved, bool attacked);
+	void on_phase(const BattleState& state); // フェーズが変わった後に呼ぶ(間隔ごとにスナップショットも書く)
+	void on_tile(int x, int y, int tile);
+	void on_spawn(const Unit& unit);
+
+	const std::vector<uint8_t>& bytes() const { return bytes_; }
+	int event_count() const { return event_count_; }
+	bool save(std::ostream& out) const;
+
+private:
+	void snapshot(const BattleState& state);
+	void finish(BattleEventType type); // payload_に書いた内容を1件としてバイト列に追加する
+
+	std::vector<uint8_t> bytes_;
+	std::vector<uint8_t> payload_; // 書きかけの1件の内容
+	int snapshot_interval_;
+	int event_count_ = 0;
+};
+
+// 盤面に取り付ける記録先
+// 記録先は盤面の値ではなく、取り付けた変数のもの
+// ・コピーやムーブで作った盤面には引き継がない(探索やAIの計画で写した盤面の変化は記録しない)
+// ・代入(コピーでもムーブでも)では代入先の記録先をそのまま残す(battle = make_default_battle()などとしても記録は止まらない)
+// 代入で盤面を丸ごと差し替えたときはその変化は出来事にならないので、続けて記録するならwriter->begin(盤面)で記録を始め直すこと
+struct BattleEventTap {
+	BattleEventWriter* writer = nullptr;
+
+	BattleEventTap() = default;
+	BattleEventTap(const BattleEventTap&) noexcept {}
+	BattleEventTap(BattleEventTap&&) noexcept {}
+	BattleEventTap& operator=(const BattleEventTap&) noexcept { return *this; }
+	BattleEventTap& operator=(BattleEventTap&&) noexcept { return *this; }
+
+	BattleEventWriter* operator->() const { return writer; }
+	explicit operator bool() const { return writer != nullptr; }
+};
+
+// 記録の再生
+class BattleReplay {
+public:
+	// バイト列を読み込んで、スナップショットの位置を調べる(壊れていればerrorに理由を入れてfalse)
+	bool load(std::vector<uint8_t> bytes, std::string& error);
+	bool load(std::istream& in, std::string& error);
+
+	// ターンturnのフェーズphaseの始まりの盤面を作る(記録にそのフェーズがなければfalse)
+	// 記録開始時の盤面はそのフェーズの始まりとして扱う
+	bool seek(int turn, Phase phase, BattleState& out) const;
+	// 記録の最後の盤面を作る
+	bool seek_end(BattleState& out) const;
+
+	int first_turn() const { return first_turn_; }
+	int last_turn() const { return last_turn_; }
+	int snapshot_count() const { return (int)snapshots_.size(); }
+
+private:
+	// スナップショット(と記録開始時の盤面)の位置
+	struct SnapshotInfo {
+		size_t offset; // 件の先頭の位置
+		int turn;
+		int phase;
+	};
+
+	bool replay(size_t from, int stop_turn, int stop_phase, BattleState& out) const;
+
+	std::vector<uint8_t> bytes_;
+	std::vector<SnapshotInfo> snapshots_;
+	int first_turn_ = 0;
+	int last_turn_ = 0;
+};
@@ -0,0 +1,43 @@
+#include "srpg/CombatLog.h"
+
+#include <cstdio>
+
+#include "srpg/Unit.h"
+
+int format_combat_log(const CombatLogEntry& entry, const UnitTable& units, char* buffer, size_t size) {
+	const char* actor = entry.actor >= 0 ? units.name(entry.actor).c_str() : "";
+	const char* target = entry.target >= 0 ? units.name(entry.target).c_str() : "";
+	int length = 0;
+	switch (entry.type) {
+	case CombatEvent::Attack:
+		length = std::snprintf(buffer, size, "%s Attack! %s Deals %d Damage ", actor, target, entry.value);
+		break;
+	case CombatEvent::Critical:
+		length = std::snprintf(buffer, size, "%s Critical! %s Deals %d Damage ", actor, target, entry.value);
+		break;
+	case CombatEvent::Dodge:
+		length = std::snprintf(buffer, size, "%s Attack! %s Dodges ", actor, target);
+		break;
+	case CombatEvent::Counter:
+		length = std::snprintf(buffer, size, "%s Counter! %s Deals %d Damage!! ", actor, target, entry.value);
+		break;
+	case CombatEvent::CriticalCounter:
+		length = std::snprintf(buffer, size, "%s Critical Counter! %s Deals %d Damage!! ", actor, target, entry.value);
+		break;
+	case CombatEvent::CounterDodge:
+		length = std::snprintf(buffer, size, "%s Counter! %s Dodges ", actor, target);
+		break;
+	case CombatEvent::Defeated:
+		length = std::snprintf(buffer, size, "%s Is Defeted ", actor);
+		break;
+	}
+	if (length < 0) length = 0;
+	if (size > 0 && (size_t)length >= size) length = (int)size - 1;
+	return length;
+}
+
+std::string format_combat_log(const CombatLogEntry& entry, const UnitTable& units) {
+	char buffer[256];
+	int length = format_combat_log(entry, units, buffer, sizeof(buffer));
+	return std::string(buffer, (size_t)length);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 戦闘ログ(固定長のリングバッファ)
+/// 文字列ではなく出来事の種類とユニットのインデックスと数値だけを記録し、文章にするのは表示するときに行う
+/// 盤面と一緒にコピーされる小さな値型で、記録してもヒープ確保をしない
+/// SRPG_NO_COMBAT_LOGを定義したビルドでは記録しない(ヘッドレスのシミュレーション向け)
+///----------------------------------------------------------------------------
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct UnitTable;
+
+constexpr size_t MAX_LOG_SIZE = 10; // 戦闘ログの最大保持数
+
+// 戦闘ログの出来事の種類
+enum class CombatEvent : uint8_t {
+	Attack,          // actorがtargetにvalueのダメージを与えた
+	Critical,        // 会心の一撃
+	Dodge,           // targetがactorの攻撃をかわした
+	Counter,         // actorの反撃でtargetにvalueのダメージを与えた
+	CriticalCounter, // 反撃が会心の一撃
+	CounterDodge,    // targetがactorの反撃をかわした
+	Defeated         // actorが倒れた
+};
+
+// 戦闘ログの1件
+struct CombatLogEntry {
+	CombatEvent type = CombatEvent::Attack;
+	int32_t actor = -1;  // 行動したユニットのインデックス
+	int32_t target = -1; // 相手のユニットのインデックス(なければ-1)
+	int32_t value = 0;   // ダメージなど
+
+	bool operator==(const CombatLogEntry& other) const = default;
+};
+
+class CombatLog {
+public:
+	static constexpr int kCapacity = (int)MAX_LOG_SIZE;
+
+	// 追加する(満杯なら最も古いものを捨てる)
+	void push(const CombatLogEntry& entry) {
+#if defined(SRPG_NO_COMBAT_LOG)
+		(void)entry;
+#else
+		head_ = head_ == 0 ? kCapacity - 1 : head_ - 1;
+		entries_[head_] = entry;
+		if (count_ < kCapacity) ++count_;
+#endif
+	}
+
+	int size() const { return count_; }
+	bool empty() const { return count_ == 0; }
+	void clear() { count_ = 0; }
+
+	// i番目に新しいもの(0が最新)
+	const CombatLogEntry& operator[](int i) const {
+		int k = head_ + i;
+		return entries_[k >= kCapacity ? k - kCapacity : k];
+	}
+
+	bool operator==(const CombatLog& other) const {
+		if (count_ != other.count_) return false;
+		for (int i = 0; i < count_; ++i) {
+			if (!((*this)[i] == other[i])) return false;
+		}
+		return true;
+	}
+
+private:
+	std::array<CombatLogEntry, kCapacity> entries_{};
+	int head_ = 0;  // 最新の要素の位置
+	int count_ = 0;
+};
+
+// 1件を文章にしてbufferに書き込む関数(書き込んだ長さを返す。収まらなければ切り詰める)
+int format_combat_log(const CombatLogEntry& entry, const UnitTable& units, char* buffer, size_t size);
+
+// 1件を文章にする関数
+std::string format_combat_log(const CombatLogEntry& entry, const UnitTable& units);
@@ -0,0 +1,69 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 戦闘の乱数(Philox4x32-10のカウンタベース乱数)
+/// 乱数は(鍵, カウンタ)だけから決まり、前の値を持ち回らないので、同じ種なら何度やり直しても同じ結果になり、
+/// 鍵を分ければ並列に走る別々の戦闘が互いに干渉しない
+/// 盤面と一緒に値としてコピーされるので、探索やシミュレーションで盤面を写しても乱数の続きがそのまま写る
+///----------------------------------------------------------------------------
+
+#include <cstdint>
+
+// 乱数1ブロック分(32ビットの乱数4つ)
+struct CombatRoll {
+	uint32_t r[4];
+};
+
+// Philox4x32-10(カウンタcounterを鍵keyで暗号化した値を乱数とする)
+inline CombatRoll philox4x32(uint64_t counter_lo, uint64_t counter_hi, uint64_t key) {
+	uint32_t c0 = (uint32_t)counter_lo;
+	uint32_t c1 = (uint32_t)(counter_lo >> 32);
+	uint32_t c2 = (uint32_t)counter_hi;
+	uint32_t c3 = (uint32_t)(counter_hi >> 32);
+	uint32_t k0 = (uint32_t)key;
+	uint32_t k1 = (uint32_t)(key >> 32);
+	for (int round = 0; round < 10; ++round) {
+		if (round > 0) {
+			k0 += 0x9E3779B9u;
+			k1 += 0xBB67AE85u;
+		}
+		const uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+		const uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+		const uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+		const uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+		c1 = (uint32_t)p1;
+		c3 = (uint32_t)p0;
+		c0 = n0;
+		c2 = n2;
+	}
+	return { { c0, c1, c2, c3 } };
+}
+
+// 32ビットの乱数でchance%の判定をする(0以下なら必ず外れ、100以上なら必ず当たる)
+inline bool roll_percent(uint32_t r, int chance) {
+	if (chance <= 0) return false;
+	if (chance >= 100) return true;
+	return (int)(((uint64_t)r * 100) >> 32) < chance;
+}
+
+// 戦闘ごとの乱数の流れ
+// counter番目のブロックはkeyとcounterだけで決まる(引く順番が変わっても、同じ番号なら同じ値)
+struct CombatRng {
+	uint64_t key = 0;     // 種(戦闘ごとに変える)
+	uint64_t counter = 0; // 次に使うブロックの番号
+
+	CombatRng() = default;
+	explicit CombatRng(uint64_t seed) : key(seed) {}
+
+	// 番号nのブロック(状態は変えない)
+	CombatRoll at(uint64_t n) const { return philox4x32(n, 0, key); }
+	// 次のブロックを引く
+	CombatRoll next() { return at(counter++); }
+
+	// 番号streamの独立した流れを作る(シミュレータの対戦ごと、探索の写しなど)
+	// 鍵はこの流れでは使わないカウンタの領域(上位64ビット)から作るので、元の流れの値とは重ならない
+	CombatRng split(uint64_t stream) const {
+		CombatRoll r = philox4x32(stream, ~0ull, key);
+		return CombatRng(((uint64_t)r.r[1] << 32) | r.r[0]);
+	}
+};
@@ -0,0 +1,58 @@
+#include "srpg/EnemyTurnJob.h"
+
+#include "srpg/WorkerPool.h"
+
+EnemyTurnJob::~EnemyTurnJob() {
+	cancel();
+}
+
+void EnemyTurnJob::start(const BattleState& state, const MctsConfig* mcts, const SkirmishConfig* endgame) {
+	if (busy()) return;
+	state_ = state;
+	use_mcts_ = mcts != nullptr;
+	if (mcts) mcts_ = *mcts;
+	use_endgame_ = endgame && is_small_skirmish(state, *endgame);
+	if (use_endgame_) endgame_ = *endgame;
+	progress_.done = 0;
+	progress_.total = 0;
+	progress_.cancel = false;
+	finished_ = false;
+	thread_ = std::thread([this] {
+		if (use_endgame_) skirmish_enemy_turn(state_, endgame_, &progress_, &plans_);
+		else if (use_mcts_) mcts_enemy_turn(state_, mcts_, default_worker_pool(), &progress_, &plans_);
+		else enemy_turn_logic(state_, default_worker_pool(), &progress_, &plans_);
+		finished_.store(true, std::memory_order_release);
+	});
+}
+
+float EnemyTurnJob::progress() const {
+	int total = progress_.total.load(std::memory_order_relaxed);
+	if (finished()) return 1.0f;
+	return total > 0 ? (float)progress_.done.load(std::memory_order_relaxed) / (float)total : 0.0f;
+}
+
+void EnemyTurnJob::cancel() {
+	if (!busy()) return;
+	progress_.cancel = true;
+	thread_.join();
+	state_ = BattleState();
+	plans_.clear();
+}
+
+bool EnemyTurnJob::take_result(BattleState& out) {
+	if (!busy() || !finished()) return false;
+	thread_.join();
+	out = std::move(state_);
+	state_ = BattleState();
+	plans_.clear();
+	return true;
+}
+
+bool EnemyTurnJob::take_plans(std::vector<EnemyPlan>& out) {
+	if (!busy() || !finished()) return false;
+	thread_.join();
+	out = std::move(plans_);
+	plans_.clear();
+	state_ = BattleState();
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// エネミーターンを別スレッドで計算するジョブ
+/// 開始時に状態を写して計算するので、計算中も元の状態はそのまま描画に使える
+/// 結果はtake_resultでまとめて受け取る(フレームの区切りで呼べば、途中の状態が描画されることはない)
+///----------------------------------------------------------------------------
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "srpg/Battle.h"
+#include "srpg/Mcts.h"
+#include "srpg/Skirmish.h"
+
+class EnemyTurnJob {
+public:
+	EnemyTurnJob() = default;
+	~EnemyTurnJob();
+
+	EnemyTurnJob(const EnemyTurnJob&) = delete;
+	EnemyTurnJob& operator=(const EnemyTurnJob&) = delete;
+
+	// stateを写してエネミーターンの計算を始める(前のジョブの結果を受け取るまでは何もしない)
+	// mctsを渡すとMCTSで計画し、渡さなければenemy_turn_logicを使う
+	// endgameを渡すと、生存ユニットが少ない(is_small_skirmish)ときはアルファベータ探索を優先する
+	void start(const BattleState& state, const MctsConfig* mcts = nullptr, const SkirmishConfig* endgame = nullptr);
+
+	// 計算中か、結果を受け取っていないジョブがあるかどうか
+	bool busy() const { return thread_.joinable(); }
+	// 計算が終わっているかどうか
+	bool finished() const { return finished_.load(std::memory_order_acquire); }
+	// 進み具合(0～1)
+	float progress() const;
+
+	// 計算を中断して結果を捨てる(戻ったときにはスレッドは終わっている)
+	void cancel();
+
+	// 計算が終わっていれば結果をoutに移してtrueを返す
+	bool take_result(BattleState& out);
+	// 計算が終わっていれば実行した計画の列をoutに移してtrueを返す(開始時の状態に順に適用すれば結果を再現できる)
+	bool take_plans(std::vector<EnemyPlan>& out);
+
+private:
+	std::thread thread_;
+	BattleState state_;
+	std::vector<EnemyPlan> plans_;
+	bool use_mcts_ = false;
+	MctsConfig mcts_;
+	bool use_endgame_ = false;
+	SkirmishConfig endgame_;
+	EnemyTurnProgress progress_;
+	std::atomic<bool> finished_{ false };
+};
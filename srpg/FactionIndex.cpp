@@ -0,0 +1,118 @@
+#include "srpg/FactionIndex.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include "srpg/Unit.h"
+
+void FactionIndex::rebuild(const UnitTable& units, int width, int height) {
+	width_ = width;
+	height_ = height;
+	cells_x_ = (width + kCellSize - 1) >> kCellShift;
+	cells_y_ = (height + kCellSize - 1) >> kCellShift;
+	for (int f = 0; f < 2; ++f) {
+		live_[f].clear();
+		head_[f].assign(cells_x_ * cells_y_, -1);
+	}
+	next_.assign(units.size(), -1);
+	prev_.assign(units.size(), -1);
+	cell_.assign(units.size(), -1);
+
+	for (int i = 0; i < units.size(); ++i) {
+		if (units.hp[i] > 0) insert(i, units.x[i], units.y[i], units.is_enemy[i] != 0);
+	}
+}
+
+void FactionIndex::insert(int unit, int x, int y, bool is_enemy) {
+	if ((int)cell_.size() <= unit) {
+		next_.resize(unit + 1, -1);
+		prev_.resize(unit + 1, -1);
+		cell_.resize(unit + 1, -1);
+	}
+	const int faction = is_enemy ? 1 : 0;
+	std::vector<int>& list = live_[faction];
+	list.insert(std::lower_bound(list.begin(), list.end(), unit), unit);
+	if (x >= 0 && y >= 0 && x < width_ && y < height_) {
+		link(unit, (y >> kCellShift) * cells_x_ + (x >> kCellShift), faction);
+	}
+}
+
+void FactionIndex::remove(int unit, bool is_enemy) {
+	const int faction = is_enemy ? 1 : 0;
+	std::vector<int>& list = live_[faction];
+	auto it = std::lower_bound(list.begin(), list.end(), unit);
+	if (it == list.end() || *it != unit) return;
+	list.erase(it);
+	if (cell_[unit] != -1) unlink(unit, faction);
+}
+
+void FactionIndex::move(int unit, int x, int y, bool is_enemy) {
+	const int faction = is_enemy ? 1 : 0;
+	int cell = -1;
+	if (x >= 0 && y >= 0 && x < width_ && y < height_) cell = (y >> kCellShift) * cells_x_ + (x >> kCellShift);
+	if (cell == cell_[unit]) return;
+	if (cell_[unit] != -1) unlink(unit, faction);
+	if (cell != -1) link(unit, cell, faction);
+}
+
+int FactionIndex::nearest(const UnitTable& units, bool is_enemy, int x, int y) const {
+	if (cells_x_ == 0 || cells_y_ == 0) return -1;
+	const std::vector<int>& head = head_[is_enemy ? 1 : 0];
+
+	int best = -1;
+	int best_dist = std::numeric_limits<int>::max();
+	auto visit_cell = [&](int cx, int cy) {
+		for (int u = head[cy * cells_x_ + cx]; u != -1; u = next_[u]) {
+			int dist = std::abs(units.x[u] - x) + std::abs(units.y[u] - y);
+			if (dist < best_dist || (dist == best_dist && u < best)) {
+				best = u;
+				best_dist = dist;
+			}
+		}
+	};
+
+	// 起点のセルから外側へ1周ずつ調べる
+	const int cx0 = clamp_cell(x >> kCellShift, cells_x_);
+	const int cy0 = clamp_cell(y >> kCellShift, cells_y_);
+	const int max_ring = std::max({ cx0, cells_x_ - 1 - cx0, cy0, cells_y_ - 1 - cy0 });
+	for (int r = 0; r <= max_ring; ++r) {
+		if (r > 0 && best != -1) {
+			// r周目のセルまでの距離の下限(内側の正方形の外に出るまでの距離)
+			int bound = std::min({
+				x - (cx0 - r + 1) * kCellSize + 1, (cx0 + r) * kCellSize - x,
+				y - (cy0 - r + 1) * kCellSize + 1, (cy0 + r) * kCellSize - y });
+			if (bound > best_dist) break;
+		}
+		for (int cy = std::max(cy0 - r, 0); cy <= std::min(cy0 + r, cells_y_ - 1); ++cy) {
+			if (cy == cy0 - r || cy == cy0 + r) {
+				// 上下の辺は横一列すべて
+				for (int cx = std::max(cx0 - r, 0); cx <= std::min(cx0 + r, cells_x_ - 1); ++cx) visit_cell(cx, cy);
+			} else {
+				// それ以外は左右の端だけ
+				if (cx0 - r >= 0) visit_cell(cx0 - r, cy);
+				if (r > 0 && cx0 + r < cells_x_) visit_cell(cx0 + r, cy);
+			}
+		}
+	}
+	return best;
+}
+
+void FactionIndex::link(int unit, int cell, int faction) {
+	std::vector<int>& head = head_[faction];
+	next_[unit] = head[cell];
+	prev_[unit] = -1;
+	if (head[cell] != -1) prev_[head[cell]] = unit;
+	head[cell] = unit;
+	cell_[unit] = cell;
+}
+
+void FactionIndex::unlink(int unit, int faction) {
+	std::vector<int>& head = head_[faction];
+	if (prev_[unit] != -1) next_[prev_[unit]] = next_[unit];
+	else head[cell_[unit]] = next_[unit];
+	if (next_[unit] != -1) prev_[next_[unit]] = prev_[unit];
+	next_[unit] = -1;
+	prev_[unit] = -1;
+	cell_[unit] = -1;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 陣営ごとの生存ユニット一覧と、ユニットの空間インデックス
+/// マップを一定サイズのセルに区切り、セルごとに陣営別の連結リストでユニットを持つ
+/// 最寄りのユニットや射程内のユニットを探すときに、近くのセルだけを見ればよくなる
+///----------------------------------------------------------------------------
+
+#include <vector>
+
+struct UnitTable;
+
+class FactionIndex {
+public:
+	static constexpr int kCellShift = 3;              // セルの一辺(2の累乗)
+	static constexpr int kCellSize = 1 << kCellShift; // 8マス(武器の最大射程の範囲が数セルに収まる)
+
+	// unitsから作り直す(マップ外のユニットは空間インデックスには入れない)
+	void rebuild(const UnitTable& units, int width, int height);
+
+	// ユニットを追加する(生存しているユニットのみ)
+	void insert(int unit, int x, int y, bool is_enemy);
+	// ユニットを取り除く(倒れたとき)
+	void remove(int unit, bool is_enemy);
+	// ユニットの位置を更新する
+	void move(int unit, int x, int y, bool is_enemy);
+
+	// 陣営の生存ユニットのインデックス一覧(インデックスの昇順)
+	const std::vector<int>& live(bool is_enemy) const { return live_[is_enemy ? 1 : 0]; }
+
+	// (x, y)から最も近い(マンハッタン距離)陣営のユニットを返す(いなければ-1、同じ距離ならインデックスの小さい方)
+	int nearest(const UnitTable& units, bool is_enemy, int x, int y) const;
+
+	// [x0, x1] x [y0, y1]の範囲に重なるセルにいる陣営のユニットを列挙する(範囲外のユニットも含むので呼び出し側で絞り込むこと)
+	template <class Func>
+	void for_each_near(bool is_enemy, int x0, int y0, int x1, int y1, Func&& func) const {
+		if (cells_x_ == 0 || cells_y_ == 0) return;
+		const std::vector<int>& head = head_[is_enemy ? 1 : 0];
+		int cx0 = clamp_cell(x0 >> kCellShift, cells_x_);
+		int cy0 = clamp_cell(y0 >> kCellShift, cells_y_);
+		int cx1 = clamp_cell(x1 >> kCellShift, cells_x_);
+		int cy1 = clamp_cell(y1 >> kCellShift, cells_y_);
+		for (int cy = cy0; cy <= cy1; ++cy) {
+			for (int cx = cx0; cx <= cx1; ++cx) {
+				for (int u = head[cy * cells_x_ + cx]; u != -1; u = next_[u]) func(u);
+			}
+		}
+	}
+
+private:
+	static int clamp_cell(int c, int count) {
+		return c < 0 ? 0 : (c >= count ? count - 1 : c);
+	}
+	void link(int unit, int cell, int faction);
+	void unlink(int unit, int faction);
+
+	int width_ = 0;
+	int height_ = 0;
+	int cells_x_ = 0;
+	int cells_y_ = 0;
+	std::vector<int> live_[2];  // 陣営ごとの生存ユニット(0: 味方、1: 敵)
+	std::vector<int> head_[2];  // 陣営ごと・セルごとの連結リストの先頭(-1なら空)
+	std::vector<int> next_;     // ユニットごとの連結リストの次(-1なら末尾)
+	std::vector<int> prev_;     // ユニットごとの連結リストの前(-1なら先頭)
+	std::vector<int> cell_;     // ユニットのいるセル(-1なら空間インデックスに入っていない)
+};
@@ -0,0 +1,66 @@
+#include "srpg/FlowField.h"
+
+#include <cassert>
+
+#include "srpg/Battle.h"
+
+void compute_flow_field(const BattleState& state, bool to_enemy, MoveClass move_class, FlowField& out) {
+	const TileGrid& grid = state.map.grid();
+	out.grid = grid;
+	out.distance.assign(grid.tile_count(), kFlowUnreachable);
+
+	assert(state.move_costs.valid()); // コストがMAX_MOVE_COSTを超えるとバケットが重なって結果が壊れる
+	const uint8_t* costs = state.move_costs.cost[(int)move_class];
+	constexpr int kBucketCount = MAX_MOVE_COST + 1;
+	std::vector<int> buckets[kBucketCount];
+	int pending = 0; // バケットに残っている要素数
+
+	// 陣営の全ユニットのマスを起点にする
+	const UnitTable& units = state.units;
+	for (int u : state.factions.live(to_enemy)) {
+		if (!grid.contains(units.x[u], units.y[u])) continue;
+		int i = grid.index(units.x[u], units.y[u]);
+		if (out.distance[i] == 0) continue;
+		out.distance[i] = 0;
+		buckets[0].push_back(i);
+		++pending;
+	}
+
+	// 起点から逆向きに広げる(マスnから隣のマスiへ進むコストはiの地形のコスト)
+	for (int d = 0; pending > 0; ++d) {
+		auto& bucket = buckets[d % kBucketCount];
+		for (size_t k = 0; k < bucket.size(); ++k) {
+			int i = bucket[k];
+			--pending;
+			if (out.distance[i] != d) continue; // より安い経路で更新済み
+			int step = d == 0 ? 1 : costs[state.map.at_index(i)];
+
+			int x = grid.x_of(i);
+			int y = grid.y_of(i);
+			const int dirs[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
+			for (auto& dir : dirs) {
+				int nx = x + dir[0];
+				int ny = y + dir[1];
+				if (!grid.contains(nx, ny)) continue;
+				int ni = grid.index(nx, ny);
+				if (costs[state.map.at_index(ni)] == IMPASSABLE) continue;
+				int nd = d + step;
+				if (nd >= out.distance[ni]) continue;
+				out.distance[ni] = nd;
+				buckets[nd % kBucketCount].push_back(ni);
+				++pending;
+			}
+		}
+		bucket.clear();
+	}
+}
+
+void compute_flow_fields(const BattleState& state, bool for_enemy, FlowFieldSet& out) {
+	out.for_enemy = for_enemy;
+	bool used[(int)MoveClass::Count] = {};
+	for (int u : state.factions.live(for_enemy)) used[(int)state.units.move_class[u]] = true;
+	for (int c = 0; c < (int)MoveClass::Count; ++c) {
+		out.computed[c] = used[c];
+		if (used[c]) compute_flow_field(state, !for_enemy, (MoveClass)c, out.fields[c]);
+	}
+}
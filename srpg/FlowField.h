@@ -0,0 +1,47 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 陣営のユニットへの距離場(フローフィールド)
+/// 陣営の全ユニットのマスを起点に、移動コストで逆向きに広げて「そのマスから最も近いユニットまでの移動コスト」を求める
+/// ユニットによる通行止めは無視するので、ターンの始めに1回計算すれば、何体の敵でも
+/// 隣の4マスの距離を見るだけ(1歩O(1))で、森などを回り込む最短経路をたどれる
+///----------------------------------------------------------------------------
+
+#include <climits>
+#include <vector>
+
+#include "srpg/TileMap.h"
+#include "srpg/Unit.h"
+
+struct BattleState;
+
+constexpr int kFlowUnreachable = INT_MAX; // 陣営のどのユニットにもたどり着けないマスの距離
+
+// 1つの移動タイプから見た距離場
+struct FlowField {
+	TileGrid grid;
+	std::vector<int> distance; // 最も近いユニットまでの移動コスト(マス番号順)
+
+	int distance_at(int x, int y) const {
+		return grid.contains(x, y) ? distance[grid.index(x, y)] : kFlowUnreachable;
+	}
+};
+
+// 陣営のユニットが使う移動タイプごとの、相手の陣営への距離場の組
+struct FlowFieldSet {
+	bool for_enemy = true;                          // どちらの陣営が使う距離場か(目標はその相手の陣営)
+	FlowField fields[(int)MoveClass::Count];
+	bool computed[(int)MoveClass::Count] = {};      // 計算した移動タイプ(陣営に生存ユニットがいるものだけ)
+
+	const FlowField* get(MoveClass move_class) const {
+		return computed[(int)move_class] ? &fields[(int)move_class] : nullptr;
+	}
+};
+
+// 陣営to_enemyの生存ユニットへの距離場を移動タイプmove_classについて計算する関数
+// 移動コストは小さい整数なので、移動範囲と同じくバケットキュー(Dialのアルゴリズム)で求める
+// ユニットのいるマスへは地形によらずコスト1で隣から入れるものとする(隣に着けば攻撃できる)
+void compute_flow_field(const BattleState& state, bool to_enemy, MoveClass move_class, FlowField& out);
+
+// 陣営for_enemyの生存ユニットが使う移動タイプすべてについて、相手の陣営への距離場を計算する関数
+void compute_flow_fields(const BattleState& state, bool for_enemy, FlowFieldSet& out);
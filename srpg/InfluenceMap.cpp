@@ -0,0 +1,96 @@
+#include "srpg/InfluenceMap.h"
+
+#include <algorithm>
+
+#include "srpg/Battle.h"
+
+void InfluenceMap::reset(const TileGrid& grid) {
+	grid_ = grid;
+	for (int l = 0; l < LayerCount; ++l) {
+		source_[l].assign(grid.tile_count(), 0);
+		value_[l].assign(grid.tile_count(), 0);
+	}
+}
+
+void InfluenceMap::add_source(Layer layer, int x, int y, int amount) {
+	if (amount == 0 || !grid_.contains(x, y)) return;
+	source_[layer][grid_.index(x, y)] += amount;
+
+	std::vector<int>& value = value_[layer];
+	const int y0 = std::max(y - kRadius, 0);
+	const int y1 = std::min(y + kRadius, grid_.height - 1);
+	const int x0 = std::max(x - kRadius, 0);
+	const int x1 = std::min(x + kRadius, grid_.width - 1);
+	for (int ty = y0; ty <= y1; ++ty) {
+		const int row = amount * weight(ty - y);
+		for (int tx = x0; tx <= x1; ++tx) value[grid_.index(tx, ty)] += row * weight(tx - x);
+	}
+}
+
+void InfluenceMap::convolve() {
+	const int w = grid_.width;
+	const int h = grid_.height;
+	pass_.assign(grid_.tile_count(), 0);
+	for (int l = 0; l < LayerCount; ++l) {
+		const std::vector<int>& source = source_[l];
+		std::vector<int>& value = value_[l];
+
+		// 横方向
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				int sum = 0;
+				for (int sx = std::max(x - kRadius, 0); sx <= std::min(x + kRadius, w - 1); ++sx) {
+					sum += source[grid_.index(sx, y)] * weight(sx - x);
+				}
+				pass_[grid_.index(x, y)] = sum;
+			}
+		}
+		// 縦方向
+		for (int y = 0; y < h; ++y) {
+			for (int x = 0; x < w; ++x) {
+				int sum = 0;
+				for (int sy = std::max(y - kRadius, 0); sy <= std::min(y + kRadius, h - 1); ++sy) {
+					sum += pass_[grid_.index(x, sy)] * weight(sy - y);
+				}
+				value[grid_.index(x, y)] = sum;
+			}
+		}
+	}
+}
+
+namespace {
+
+// 歩兵が進入できるマスかどうか(地形の層の源)
+int terrain_source(const BattleState& state, int x, int y) {
+	return state.move_costs.at(MoveClass::Infantry, state.map.at(x, y)) != IMPASSABLE ? 1 : 0;
+}
+
+} // namespace
+
+void rebuild_influence(BattleState& state) {
+	InfluenceMap& influence = state.influence;
+	influence.reset(state.map.grid());
+	for (int y = 0; y < state.map.height(); ++y) {
+		for (int x = 0; x < state.map.width(); ++x) {
+			if (terrain_source(state, x, y)) influence.accumulate_source(InfluenceMap::Terrain, x, y, 1);
+		}
+	}
+	const UnitTable& u = state.units;
+	for (int i = 0; i < u.size(); ++i) {
+		if (u.hp[i] <= 0) continue;
+		if (u.is_enemy[i]) influence.accumulate_source(InfluenceMap::Support, u.x[i], u.y[i], 1);
+		else influence.accumulate_source(InfluenceMap::Threat, u.x[i], u.y[i], u.atk[i]);
+	}
+	influence.convolve();
+}
+
+void stamp_unit_influence(BattleState& state, int unit_index, int sign) {
+	const UnitTable& u = state.units;
+	if (u.is_enemy[unit_index]) state.influence.add_source(InfluenceMap::Support, u.x[unit_index], u.y[unit_index], sign);
+	else state.influence.add_source(InfluenceMap::Threat, u.x[unit_index], u.y[unit_index], sign * u.atk[unit_index]);
+}
+
+void update_terrain_influence(BattleState& state, int x, int y) {
+	InfluenceMap& influence = state.influence;
+	influence.add_source(InfluenceMap::Terrain, x, y, terrain_source(state, x, y) - influence.source_at(InfluenceMap::Terrain, x, y));
+}
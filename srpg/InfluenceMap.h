@@ -0,0 +1,72 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 影響マップ(プレイヤーの脅威・敵の支援・地形の広さ)
+/// ユニットや進入できるマスを「源」とし、距離で減衰するカーネルで周りに広げた値を層ごとに持つ
+/// カーネルは1次元の重みの積なので、作り直すときは横と縦に分けて畳み込む
+/// 値は整数なので、ユニットが動いたときに源1つ分だけ足し引きしても作り直した結果と完全に一致する
+///----------------------------------------------------------------------------
+
+#include <vector>
+
+#include "srpg/TileMap.h"
+
+struct BattleState;
+
+class InfluenceMap {
+public:
+	static constexpr int kRadius = 3;           // カーネルの半径(縦横それぞれこれより離れたマスには影響しない)
+	static constexpr int kReach = 2 * kRadius;  // 源が影響するマスまでのマンハッタン距離の最大(カーネルは正方形)
+
+	// 層の種類
+	enum Layer {
+		Threat,  // プレイヤーユニットの脅威(源は攻撃力)
+		Support, // 敵ユニットの支援(源は1体1)
+		Terrain, // 地形の広さ(源は歩兵が進入できるマス)
+		LayerCount
+	};
+
+	// 1次元の距離dの重み(中心が最大で、1マス離れるごとに半分になる)
+	static constexpr int weight(int d) {
+		d = d < 0 ? -d : d;
+		return d > kRadius ? 0 : 1 << (kRadius - d);
+	}
+	// (sx, sy)にある量amountの源が(x, y)に与える値
+	static constexpr int contribution(int amount, int sx, int sy, int x, int y) {
+		return amount * weight(x - sx) * weight(y - sy);
+	}
+
+	// すべての層を空にする
+	void reset(const TileGrid& grid);
+	// 源にamountを足し、周りの値も更新する(マップ外なら何もしない)
+	void add_source(Layer layer, int x, int y, int amount);
+	// 源にamountを足すだけで、値はconvolveまで更新しない(まとめて作り直すとき用)
+	void accumulate_source(Layer layer, int x, int y, int amount) {
+		if (grid_.contains(x, y)) source_[layer][grid_.index(x, y)] += amount;
+	}
+	// すべての層を源から計算し直す(横と縦に分けた畳み込み)
+	void convolve();
+
+	const TileGrid& grid() const { return grid_; }
+	int at(Layer layer, int x, int y) const {
+		return grid_.contains(x, y) ? value_[layer][grid_.index(x, y)] : 0;
+	}
+	int source_at(Layer layer, int x, int y) const {
+		return grid_.contains(x, y) ? source_[layer][grid_.index(x, y)] : 0;
+	}
+
+private:
+	TileGrid grid_;
+	std::vector<int> source_[LayerCount]; // 層ごとの源(マス番号順)
+	std::vector<int> value_[LayerCount];  // 層ごとの値(マス番号順)
+	std::vector<int> pass_;               // 横方向に畳み込んだ途中の結果
+};
+
+// 盤面から影響マップを作り直す関数(rebuild_occupancyから呼ばれる)
+void rebuild_influence(BattleState& state);
+
+// ユニットの影響を足す(sign = 1)か引く(sign = -1)関数(ユニットの現在の位置で行う)
+void stamp_unit_influence(BattleState& state, int unit_index, int sign);
+
+// マスの地形が変わったときに地形の層を更新する関数
+void update_terrain_influence(BattleState& state, int x, int y);
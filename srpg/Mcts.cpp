@@ -0,0 +1,271 @@
+#include "srpg/Mcts.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "srpg/ThreatMap.h"
+#include "srpg/UnitActions.h"
+#include "srpg/WorkerPool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kKillBonus = 10.0;   // 撃破1体あたりの評価(hpに換算)
+constexpr double kThreatWeight = 0.5; // 次のプレイヤーターンに受けうるダメージの重み
+constexpr double kScoreScale = 10.0;  // 評価値を0～1の報酬に変換するときの幅
+
+// 探索木のノード(子は連続して並ぶ)
+struct Node {
+	int first_child = -1;
+	int child_count = 0;
+	bool expanded = false;
+	EnemyPlan plan;     // 親の状態からこのノードに進む行動
+	int visits = 0;
+	double value = 0.0; // 報酬の合計
+};
+
+// ワーカーごとの探索の作業領域
+struct MctsWorker {
+	std::vector<Node> nodes;
+	std::vector<int> path;
+	EnemyPlanScratch scratch;
+	std::vector<EnemyPlan> actions;
+	ThreatMap threat;
+	std::mt19937_64 rng;
+	CombatRng combat_rng; // 探索中の命中と会心の判定に使う流れ(実際の戦闘の乱数とは別にする)
+};
+
+// 1体の行動を決める探索の入力
+struct SearchRoot {
+	BattleState state;              // この敵の手番の直前の状態(戦闘ログは空にしておく)
+	const std::vector<int>* enemies; // 行動順の敵の一覧
+	size_t first = 0;               // 根で行動する敵の一覧内の位置
+	const std::vector<int>* start_hp; // ターン開始時のhp(評価用)
+	const MctsConfig* config;
+	bool has_deadline = false;
+	Clock::time_point deadline;
+	const std::atomic<bool>* cancel = nullptr; // 立ったら探索を打ち切る
+};
+
+// 一覧のpos番目以降で最初に生きている敵の位置
+size_t next_alive(const BattleState& state, const std::vector<int>& enemies, size_t pos) {
+	while (pos < enemies.size() && state.units.hp[enemies[pos]] <= 0) ++pos;
+	return pos;
+}
+
+// 敵1体の行動候補(先頭は貪欲AIの行動)
+void generate_actions(const BattleState& state, int unit, int max_actions, MctsWorker& w, std::vector<EnemyPlan>& out) {
+	EnemyPlan greedy = plan_enemy_action(state, unit, w.scratch, false);
+	enumerate_unit_actions(state, unit, w.scratch, max_actions, w.actions);
+	out.clear();
+	if (greedy.target < 0) return;
+	out.push_back(greedy);
+	for (const auto& a : w.actions) {
+		if ((int)out.size() >= max_actions) break;
+		bool duplicate = false;
+		for (const auto& b : out) duplicate = duplicate || same_unit_action(state, a, b);
+		if (!duplicate) out.push_back(a);
+	}
+}
+
+// エネミーターンを終えた盤面の評価(敵から見た報酬、0～1)
+double evaluate(const BattleState& state, const SearchRoot& root, MctsWorker& w) {
+	const UnitTable& units = state.units;
+	double score = 0.0;
+	for (int i = 0; i < units.size(); ++i) {
+		int before = std::max((*root.start_hp)[i], 0);
+		int after = std::max(units.hp[i], 0);
+		double loss = before - after;
+		if (before > 0 && after == 0) loss += kKillBonus;
+		score += units.is_enemy[i] ? -loss : loss;
+	}
+
+	// 次のプレイヤーターンに攻撃されうる敵の被害を見込む
+	compute_threat_map(state, false, w.threat);
+	for (int e : state.factions.live(true)) {
+		int damage = w.threat.max_damage_at(units.x[e], units.y[e], units.def[e]);
+		if (damage > 0) score -= kThreatWeight * damage;
+	}
+	return 1.0 / (1.0 + std::exp(-score / kScoreScale));
+}
+
+// UCTで子を選ぶ(未訪問の子があれば先に選ぶ)
+int select_child(const MctsWorker& w, int node, double exploration) {
+	const Node& parent = w.nodes[node];
+	double log_visits = std::log((double)std::max(parent.visits, 1));
+	int best = -1;
+	double best_score = -std::numeric_limits<double>::infinity();
+	for (int c = parent.first_child; c < parent.first_child + parent.child_count; ++c) {
+		const Node& child = w.nodes[c];
+		if (child.visits == 0) return c;
+		double score = child.value / child.visits + exploration * std::sqrt(log_visits / child.visits);
+		if (score > best_score) {
+			best_score = score;
+			best = c;
+		}
+	}
+	return best;
+}
+
+// 1本の木を育てる
+void run_search(const SearchRoot& root, MctsWorker& w) {
+	const MctsConfig& config = *root.config;
+	const std::vector<int>& enemies = *root.enemies;
+	w.nodes.clear();
+	w.nodes.emplace_back();
+
+	std::vector<EnemyPlan> actions;
+	for (int iteration = 0; iteration < config.max_iterations; ++iteration) {
+		if (root.has_deadline && iteration > 0 && Clock::now() >= root.deadline) break;
+		if (root.cancel && root.cancel->load(std::memory_order_relaxed)) break;
+
+		// 反復ごとに別の乱数の流れで判定する(実際の戦闘で出る値を探索が先読みしないように)
+		BattleState state = root.state;
+		state.rng = w.combat_rng.split((uint64_t)iteration);
+		size_t pos = root.first;
+		int node = 0;
+		w.path.clear();
+		w.path.push_back(node);
+
+		// 選択
+		// 木の行動は別の反復の判定結果の上で作ったものなので、今回の盤面で実行できなくなっていたら
+		// (手番の敵が倒れた、移動先がふさがった、相手が倒れたなど)そこで降りるのをやめてプレイアウトに移る
+		while (w.nodes[node].expanded && w.nodes[node].child_count > 0) {
+			int child = select_child(w, node, config.exploration);
+			const EnemyPlan& plan = w.nodes[child].plan;
+			if (pos >= enemies.size() || plan.unit != enemies[pos] || !is_enemy_plan_valid(state, plan, w.scratch.move)) {
+				break;
+			}
+			node = child;
+			w.path.push_back(node);
+			apply_enemy_plan(state, plan);
+			pos = next_alive(state, enemies, pos + 1);
+		}
+
+		// 展開
+		if (!w.nodes[node].expanded) {
+			w.nodes[node].expanded = true;
+			if (pos < enemies.size()) {
+				generate_actions(state, enemies[pos], config.max_actions, w, actions);
+				int first = (int)w.nodes.size();
+				for (const auto& a : actions) {
+					Node child;
+					child.plan = a;
+					w.nodes.push_back(child);
+				}
+				w.nodes[node].first_child = first;
+				w.nodes[node].child_count = (int)actions.size();
+				if (!actions.empty()) {
+					node = first;
+					w.path.push_back(node);
+					apply_enemy_plan(state, w.nodes[node].plan);
+				}
+				pos = next_alive(state, enemies, pos + 1);
+			}
+		}
+
+		// プレイアウト(残りの敵を貪欲AIで、たまにランダムな候補で動かす)
+		std::uniform_real_distribution<double> coin(0.0, 1.0);
+		while (pos < enemies.size()) {
+			int e = enemies[pos];
+			if (coin(w.rng) < config.greedy_rollout) {
+				apply_enemy_plan(state, plan_enemy_action(state, e, w.scratch, false));
+			} else {
+				enumerate_unit_actions(state, e, w.scratch, config.max_actions, w.actions);
+				if (!w.actions.empty()) apply_enemy_plan(state, w.actions[w.rng() % w.actions.size()]);
+			}
+			pos = next_alive(state, enemies, pos + 1);
+		}
+
+		// 逆伝播
+		double reward = evaluate(state, root, w);
+		for (int n : w.path) {
+			w.nodes[n].visits += 1;
+			w.nodes[n].value += reward;
+		}
+	}
+}
+
+} // namespace
+
+void mcts_enemy_turn(BattleState& state, const MctsConfig& config, WorkerPool& pool,
+	EnemyTurnProgress* progress, std::vector<EnemyPlan>* committed) {
+	const std::vector<int> enemies = state.factions.live(true);
+	auto cancelled = [&] { return progress && progress->cancel.load(std::memory_order_relaxed); };
+	if (progress) {
+		progress->done = 0;
+		progress->total = (int)enemies.size();
+	}
+	if (committed) committed->clear();
+
+	const std::vector<int> start_hp = state.units.hp;
+	const Clock::time_point start = Clock::now();
+	const Clock::time_point turn_deadline = start + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double, std::milli>(config.time_budget_ms));
+
+	// 相手への距離場はターンの始めに1回だけ計算し、貪欲AIとプレイアウトで共有する
+	FlowFieldSet flow;
+	compute_flow_fields(state, true, flow);
+	std::vector<MctsWorker> workers(pool.size());
+	for (auto& w : workers) w.scratch.flow = &flow;
+	std::vector<EnemyPlan> root_actions;
+	std::vector<int> visits;
+
+	for (size_t k = 0; k < enemies.size(); ++k) {
+		if (cancelled()) return;
+		if (progress) progress->done = (int)k;
+		int ei = enemies[k];
+		if (state.units.hp[ei] <= 0) continue;
+
+		// 候補が1つ以下なら探索しない
+		generate_actions(state, ei, config.max_actions, workers[0], root_actions);
+		EnemyPlan chosen;
+		if (root_actions.size() <= 1) {
+			chosen = root_actions.empty() ? plan_enemy_action(state, ei, workers[0].scratch, false) : root_actions[0];
+		} else {
+			SearchRoot root;
+			root.state = state;
+			root.state.combat_log.clear();
+			root.enemies = &enemies;
+			root.first = k;
+			root.start_hp = &start_hp;
+			root.config = &config;
+			if (progress) root.cancel = &progress->cancel;
+			if (config.time_budget_ms > 0.0) {
+				// 残りの時間を残りの敵で等分する
+				Clock::time_point now = Clock::now();
+				root.has_deadline = true;
+				root.deadline = now + (turn_deadline > now ? (turn_deadline - now) / (Clock::rep)(enemies.size() - k) : Clock::duration::zero());
+			}
+
+			// ワーカーごとに別々の木を育てて、根の子の訪問回数を合計する
+			pool.parallel_for((int)workers.size(), [&](int tree, int) {
+				MctsWorker& w = workers[tree];
+				w.rng.seed(config.seed ^ (0x9E3779B97F4A7C15ull * (k + 1)) ^ (0xBF58476D1CE4E5B9ull * (uint64_t)(tree + 1)));
+				w.combat_rng = root.state.rng.split(((uint64_t)k << 32) | (uint64_t)tree);
+				run_search(root, w);
+			});
+			visits.assign(root_actions.size(), 0);
+			for (const auto& w : workers) {
+				if (w.nodes.empty() || w.nodes[0].child_count != (int)root_actions.size()) continue;
+				for (int c = 0; c < w.nodes[0].child_count; ++c) visits[c] += w.nodes[w.nodes[0].first_child + c].visits;
+			}
+			// 最も訪問回数の多い行動を選ぶ(同じなら先の候補、つまり貪欲AIの行動を優先)
+			size_t best = 0;
+			for (size_t c = 1; c < visits.size(); ++c) {
+				if (visits[c] > visits[best]) best = c;
+			}
+			chosen = root_actions[best];
+		}
+
+		apply_enemy_plan(state, chosen);
+		if (committed) committed->push_back(chosen);
+	}
+	if (cancelled()) return;
+	if (progress) progress->done = (int)enemies.size();
+	end_enemy_turn(state);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// モンテカルロ木探索によるエネミーターンの計画
+/// 敵を1体ずつ順に、その敵の行動候補を根とし、残りの敵の行動を深さ方向に並べた木を探索して決める
+/// ワーカーごとに別々の木を育て(ルート並列)、根の子の訪問回数を合計して最も多い行動を選ぶ
+/// プレイアウトでは残りの敵を貪欲AI(たまにランダムな候補)で動かし、最後の盤面を
+/// 与えた/受けたダメージと撃破数、次のプレイヤーターンに受けうるダメージで評価する
+///----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <vector>
+
+#include "srpg/Battle.h"
+
+class WorkerPool;
+
+struct MctsConfig {
+	double time_budget_ms = 200.0; // エネミーターン全体で探索に使う時間(0以下なら試行回数だけで打ち切るので結果が毎回同じになる)
+	int max_iterations = 2000;     // 1体の行動を決めるときの、ワーカーごとの試行回数の上限
+	int max_actions = 8;           // 1体あたりの行動候補の上限
+	double exploration = 1.0;      // UCTの探索の重み
+	double greedy_rollout = 0.75;  // プレイアウトで貪欲AIの行動を選ぶ確率
+	uint64_t seed = 1;             // 乱数の種
+};
+
+// MCTSでエネミーターンを実行する関数(引数の意味はenemy_turn_logicと同じ)
+void mcts_enemy_turn(BattleState& state, const MctsConfig& config, WorkerPool& pool,
+	EnemyTurnProgress* progress = nullptr, std::vector<EnemyPlan>* committed = nullptr);
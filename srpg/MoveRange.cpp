@@ -0,0 +1,129 @@
+#include "srpg/MoveRange.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "srpg/Battle.h"
+
+void search_move_range(const BattleState& state, int unit_index, MoveScratch& scratch) {
+	const TileGrid& grid = state.map.grid();
+	scratch.prepare(grid);
+	scratch.reached.clear();
+
+	// 世代番号を進めてvisitedを一括で無効化する(一周したときだけ実際に消す)
+	if (++scratch.generation == 0) {
+		std::fill(scratch.visited.begin(), scratch.visited.end(), 0u);
+		scratch.generation = 1;
+	}
+	const UnitTable& units = state.units;
+	const int ux = units.x[unit_index];
+	const int uy = units.y[unit_index];
+	const int move = units.move[unit_index];
+	const uint8_t is_enemy = units.is_enemy[unit_index];
+	if (!is_within_bounds(state, ux, uy) || !is_tile_passable(state, unit_index, ux, uy)) return;
+
+	assert(state.move_costs.valid()); // コストがMAX_MOVE_COSTを超えるとバケットが重なって結果が壊れる
+	const uint32_t gen = scratch.generation;
+	const uint8_t* costs = state.move_costs.cost[(int)units.move_class[unit_index]];
+	constexpr int kBucketCount = MAX_MOVE_COST + 1;
+	for (auto& bucket : scratch.buckets) bucket.clear();
+
+	int start = grid.index(ux, uy);
+	scratch.visited[start] = gen;
+	scratch.distance[start] = 0;
+	scratch.buckets[0].push_back(start);
+	int pending = 1; // バケットに残っている要素数
+
+	// コストの小さい順にバケットを取り出す(1回の移動のコストはMAX_MOVE_COST以下なので、
+	// 現在のコストからMAX_MOVE_COST先までのバケットだけを循環して使える)
+	for (int d = 0; d <= move && pending > 0; ++d) {
+		auto& bucket = scratch.buckets[d % kBucketCount];
+		// 処理中に同じバケットへは積まれない(コストは1以上)ので添字で回す
+		for (size_t k = 0; k < bucket.size(); ++k) {
+			int i = bucket[k];
+			--pending;
+			if (scratch.distance[i] != d) continue; // より安い経路で更新済み
+			scratch.reached.push_back(i);
+
+			int x = grid.x_of(i);
+			int y = grid.y_of(i);
+			const int dirs[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
+			for (auto& dir : dirs) {
+				int nx = x + dir[0];
+				int ny = y + dir[1];
+				if (!grid.contains(nx, ny)) continue;
+				int ni = grid.index(nx, ny);
+				uint8_t cost = costs[state.map.at_index(ni)];
+				if (cost == IMPASSABLE) continue;
+				int nd = d + cost;
+				if (nd > move) continue;
+				if (scratch.visited[ni] == gen && scratch.distance[ni] <= nd) continue;
+				// 敵対するユニットのマスは通り抜けられない
+				int occupant = state.occupancy[ni] - 1;
+				if (occupant != NO_UNIT && units.is_enemy[occupant] != is_enemy) continue;
+				scratch.visited[ni] = gen;
+				scratch.distance[ni] = nd;
+				scratch.buckets[nd % kBucketCount].push_back(ni);
+				++pending;
+			}
+		}
+		bucket.clear();
+	}
+}
+
+void get_move_range(const BattleState& state, int unit_index, TileSet& out, MoveScratch& scratch) {
+	const TileGrid& grid = state.map.grid();
+	if (out.grid() == grid) out.clear();
+	else out.reset(grid);
+
+	search_move_range(state, unit_index, scratch);
+	for (int i : scratch.reached) out.set(i);
+}
+
+TileSet get_move_range(const BattleState& state, int unit_index) {
+	thread_local MoveScratch scratch;
+	TileSet result;
+	get_move_range(state, unit_index, result, scratch);
+	return result;
+}
+
+const std::vector<int>& MoveRangeCache::get(const BattleState& state, int unit_index) {
+	if ((int)entries_.size() < state.units.size()) entries_.resize(state.units.size());
+
+	const UnitTable& u = state.units;
+	Entry& e = entries_[unit_index];
+	if (e.valid && e.x == u.x[unit_index] && e.y == u.y[unit_index] && e.move == u.move[unit_index] &&
+		e.move_class == (int)u.move_class[unit_index] && e.is_enemy == (u.is_enemy[unit_index] != 0)) {
+		return e.tiles;
+	}
+
+	search_move_range(state, unit_index, scratch_);
+	e.valid = true;
+	e.x = u.x[unit_index];
+	e.y = u.y[unit_index];
+	e.move = u.move[unit_index];
+	e.move_class = (int)u.move_class[unit_index];
+	e.is_enemy = u.is_enemy[unit_index] != 0;
+	e.tiles.assign(scratch_.reached.begin(), scratch_.reached.end());
+	return e.tiles;
+}
+
+void MoveRangeCache::invalidate_tile(int x, int y, bool mover_is_enemy) {
+	for (auto& e : entries_) {
+		if (e.valid && e.is_enemy != mover_is_enemy && e.covers(x, y)) e.valid = false;
+	}
+}
+
+void MoveRangeCache::invalidate_tile(int x, int y) {
+	for (auto& e : entries_) {
+		if (e.valid && e.covers(x, y)) e.valid = false;
+	}
+}
+
+void MoveRangeCache::invalidate_all() {
+	for (auto& e : entries_) e.valid = false;
+}
+
+const std::vector<int>& get_cached_move_range(const BattleState& state, int unit_index) {
+	return state.move_cache.get(state, unit_index);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 移動範囲の計算とキャッシュ
+///----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <vector>
+
+#include "srpg/TileMap.h"
+
+struct BattleState;
+
+constexpr uint8_t IMPASSABLE = 0xFF; // 進入できない地形の移動コスト
+constexpr int MAX_MOVE_COST = 4;     // 進入できる地形の移動コストの上限(移動範囲計算のバケット数を決める。これを超えるコストは使えない)
+
+// 移動範囲計算の作業領域(使い回せば移動範囲の計算でヒープ確保が起きない)
+struct MoveScratch {
+	TileGrid grid;
+	std::vector<int> distance;  // 開始マスからの移動コスト(visitedがgenerationと一致するマスのみ有効)
+	std::vector<uint32_t> visited;
+	uint32_t generation = 0;
+	std::vector<int> buckets[MAX_MOVE_COST + 1]; // 移動コストごとのバケット(コスト % (MAX_MOVE_COST + 1)で循環させる)
+	std::vector<int> reached;   // 直前の計算で到達したマス番号(移動コストの小さい順)
+
+	// マップの形状に合わせて領域を用意する(同じ形状なら何もしない)
+	void prepare(const TileGrid& g) {
+		if (grid == g && (int)distance.size() == g.tile_count()) return;
+		grid = g;
+		distance.assign(g.tile_count(), 0);
+		visited.assign(g.tile_count(), 0);
+		generation = 0;
+	}
+
+	// 直前の計算で到達したマスまでの移動コスト(到達していなければ-1)
+	int distance_at(int x, int y) const {
+		if (!grid.contains(x, y)) return -1;
+		int i = grid.index(x, y);
+		return generation != 0 && visited[i] == generation ? distance[i] : -1;
+	}
+};
+
+// ユニットの移動範囲を計算する関数(到達したマスと移動コストをscratchに書き込む)
+// 移動コストが小さい整数なので、優先度付きキューではなくバケットキュー(Dialのアルゴリズム)で最短コストを求める
+// 敵対するユニットがいるマスは通り抜けられない(味方のマスは通り抜けられる)
+void search_move_range(const BattleState& state, int unit_index, MoveScratch& scratch);
+
+// ユニットの移動範囲を計算する関数(結果はoutに、移動コストはscratchに書き込む)
+void get_move_range(const BattleState& state, int unit_index, TileSet& out, MoveScratch& scratch);
+
+// ユニットの移動範囲を計算する関数(スレッドごとの作業領域を使う)
+TileSet get_move_range(const BattleState& state, int unit_index);
+
+// ユニットごとの移動範囲のキャッシュ
+// ユニットの位置・移動力・移動タイプが同じで、移動範囲に影響するマス(移動力以内のマンハッタン距離)で
+// 敵対ユニットの出入りや地形の変更がなければ、前回の結果をそのまま返す
+class MoveRangeCache {
+public:
+	// 移動範囲のマス番号一覧を返す(次にこのユニットの範囲を取得するまで有効)
+	const std::vector<int>& get(const BattleState& state, int unit_index);
+
+	// マスにユニットが出入りした(mover_is_enemyはそのユニットの陣営、敵対する陣営の範囲だけ無効にする)
+	void invalidate_tile(int x, int y, bool mover_is_enemy);
+	// マスの地形が変わった(両陣営の範囲を無効にする)
+	void invalidate_tile(int x, int y);
+	// すべて無効にする(ユニットの追加や移動コスト表の変更など)
+	void invalidate_all();
+
+private:
+	struct Entry {
+		bool valid = false;
+		int x = 0;
+		int y = 0;
+		int move = 0;
+		int move_class = 0;
+		bool is_enemy = false;
+		std::vector<int> tiles; // 移動範囲のマス番号
+
+		// マスが移動範囲に影響しうる距離にあるかどうか
+		bool covers(int tx, int ty) const {
+			int dx = tx > x ? tx - x : x - tx;
+			int dy = ty > y ? ty - y : y - ty;
+			return dx + dy <= move;
+		}
+	};
+	std::vector<Entry> entries_; // ユニットのインデックス順
+	MoveScratch scratch_;
+};
+
+// キャッシュ経由でユニットの移動範囲(マス番号の一覧)を取得する関数
+const std::vector<int>& get_cached_move_range(const BattleState& state, int unit_index);
@@ -0,0 +1,137 @@
+#include "srpg/Scenario.h"
+
+#include <cstdlib>
+#include <sstream>
+#include <utility>
+
+#include "srpg/Battle.h"
+
+namespace {
+
+// 武器タイプの名前(WeaponTypeの順)
+const char* const kWeaponNames[(int)WeaponType::Count] = { "sword", "bow", "lance", "longbow" };
+// 移動タイプの名前(MoveClassの順)
+const char* const kMoveClassNames[(int)MoveClass::Count] = { "infantry", "cavalry", "flying" };
+
+// コメントを除く
+std::string strip_comment(const std::string& line) {
+	size_t p = line.find('#');
+	return p == std::string::npos ? line : line.substr(0, p);
+}
+
+} // namespace
+
+bool parse_weapon_type(const std::string& name, WeaponType& out) {
+	for (int i = 0; i < (int)WeaponType::Count; ++i) {
+		if (name == kWeaponNames[i]) {
+			out = (WeaponType)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool parse_move_class(const std::string& name, MoveClass& out) {
+	for (int i = 0; i < (int)MoveClass::Count; ++i) {
+		if (name == kMoveClassNames[i]) {
+			out = (MoveClass)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+Scenario make_default_scenario() {
+	BattleState state = make_default_battle();
+	Scenario scenario;
+	scenario.map = state.map;
+	for (int i = 0; i < state.units.size(); ++i) scenario.units.push_back(state.units.get(i));
+	return scenario;
+}
+
+bool load_scenario(std::istream& in, Scenario& out, std::string& error) {
+	Scenario scenario;
+	std::vector<int> unit_lines; // ユニットを書いた行(マップとの照合でエラーに使う)
+	bool has_map = false;
+	std::string line;
+	int line_no = 0;
+	auto fail = [&](const std::string& message) {
+		error = "line " + std::to_string(line_no) + ": " + message;
+		return false;
+	};
+
+	while (std::getline(in, line)) {
+		++line_no;
+		std::istringstream words(strip_comment(line));
+		std::string keyword;
+		if (!(words >> keyword)) continue; // 空行
+
+		if (keyword == "map") {
+			// endまでの行をまとめてマップとして読む
+			std::string rows;
+			bool closed = false;
+			while (std::getline(in, line)) {
+				++line_no;
+				std::string row = strip_comment(line);
+				std::istringstream check(row);
+				std::string word;
+				if (check >> word && word == "end") {
+					closed = true;
+					break;
+				}
+				rows += row + "\n";
+			}
+			if (!closed) return fail("map without end");
+			std::istringstream map_in(rows);
+			if (!load_tile_map(map_in, scenario.map)) return fail("invalid map");
+			has_map = true;
+		}
+		else if (keyword == "unit") {
+			Unit unit{};
+			std::string side, weapon, option;
+			if (!(words >> unit.name >> side >> unit.x >> unit.y >> unit.hp >> unit.move >> unit.atk >> unit.def >> weapon)) {
+				return fail("unit needs <name> <ally|enemy> <x> <y> <hp> <move> <atk> <def> <weapon>");
+			}
+			if (unit.hp <= 0) return fail("hp must be positive");
+			if (unit.move < 0 || unit.atk < 0 || unit.def < 0) return fail("move, atk and def must not be negative");
+			if (side != "ally" && side != "enemy") return fail("unknown side '" + side + "'");
+			unit.is_enemy = side == "enemy";
+			if (!parse_weapon_type(weapon, unit.weapon)) return fail("unknown weapon '" + weapon + "'");
+			// 残りは移動タイプと、hit=/crit=の指定(順不同)
+			while (words >> option) {
+				size_t eq = option.find('=');
+				if (eq == std::string::npos) {
+					if (!parse_move_class(option, unit.move_class)) return fail("unknown move class '" + option + "'");
+					continue;
+				}
+				std::string key = option.substr(0, eq);
+				char* end = nullptr;
+				long value = std::strtol(option.c_str() + eq + 1, &end, 10);
+				if (eq + 1 == option.size() || *end != '\0') return fail("invalid value in '" + option + "'");
+				if (key == "hit") unit.hit = (int)value;
+				else if (key == "crit") unit.crit = (int)value;
+				else return fail("unknown option '" + key + "'");
+				if (value < 0 || value > 100) return fail("'" + key + "' must be 0-100");
+			}
+			scenario.units.push_back(std::move(unit));
+			unit_lines.push_back(line_no);
+		}
+		else {
+			return fail("unknown keyword '" + keyword + "'");
+		}
+	}
+
+	if (!has_map) return fail("no map");
+	// マップはユニットより後に書いてもよいので、位置は最後にまとめて確かめる
+	std::vector<uint8_t> occupied(scenario.map.grid().tile_count(), 0);
+	for (size_t i = 0; i < scenario.units.size(); ++i) {
+		const Unit& unit = scenario.units[i];
+		line_no = unit_lines[i];
+		if (!scenario.map.contains(unit.x, unit.y)) return fail("unit '" + unit.name + "' is outside the map");
+		uint8_t& tile = occupied[scenario.map.index(unit.x, unit.y)];
+		if (tile) return fail("unit '" + unit.name + "' is on an occupied tile");
+		tile = 1;
+	}
+	out = std::move(scenario);
+	return true;
+}
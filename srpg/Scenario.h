@@ -0,0 +1,37 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 対戦のシナリオ(マップと初期配置)をテキストから読み込む
+/// バランス調整用のシミュレータなどで、コードを書き換えずに配置や能力値を差し替えられるようにする
+///----------------------------------------------------------------------------
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "srpg/TileMap.h"
+#include "srpg/Unit.h"
+
+// 対戦の初期状態(make_battleに渡す前のもの)
+struct Scenario {
+	TileMap map;
+	std::vector<Unit> units;
+};
+
+// 既定の対戦(make_default_battleと同じマップと配置)
+Scenario make_default_scenario();
+
+// テキストからシナリオを読み込む関数
+// 書式(#から行末まではコメント):
+//   map                 … 次の行からendまでをload_tile_mapの書式のマップとして読む
+//   0000
+//   0120
+//   end
+//   unit <名前> <ally|enemy> <x> <y> <hp> <移動力> <攻撃力> <防御力> <sword|bow|lance|longbow> [infantry|cavalry|flying] [hit=<命中率>] [crit=<会心率>]
+// hpは1以上、移動力・攻撃力・防御力は0以上、命中率・会心率は0～100で、ユニットはマップ内の別々のマスに置く
+// 読めなければerrorに理由(行番号付き)を入れてfalseを返す
+bool load_scenario(std::istream& in, Scenario& out, std::string& error);
+
+// 武器タイプ・移動タイプと名前の変換(見つからなければfalse)
+bool parse_weapon_type(const std::string& name, WeaponType& out);
+bool parse_move_class(const std::string& name, MoveClass& out);
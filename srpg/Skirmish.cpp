@@ -0,0 +1,285 @@
+#include "srpg/Skirmish.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "srpg/UnitActions.h"
+
+namespace {
+
+constexpr int kAliveValue = 10;                      // 生き残っているユニット1体の価値(hpに換算)
+constexpr int kWinThreshold = kSkirmishWin - 1000;   // これより大きい評価値は勝敗が確定している
+constexpr uint64_t kZobristSeed = 0x5EED5EEDC0FFEEull;
+constexpr uint64_t kSearchRngStream = 0x5EA7C4ull;   // 探索の写しで使う乱数の流れ(実際の戦闘の値を先読みしないように)
+
+// 置換表の値の種類
+enum Bound : uint8_t {
+	Exact, // 正確な値
+	Lower, // 下限(ベータカット)
+	Upper  // 上限(アルファカット)
+};
+
+// Zobristハッシュのキーの種類
+enum class KeyKind : uint64_t {
+	Size,
+	Tile,
+	Position,
+	Hp,
+	Acted,
+	Dead,
+	Side,
+	Rng
+};
+
+// 種類と2つの値から決まる乱数(表を持たずにZobristのキーを作る)
+uint64_t zobrist(KeyKind kind, int a, int b) {
+	uint64_t z = kZobristSeed ^ ((uint64_t)kind << 56) ^ ((uint64_t)(uint32_t)a << 28) ^ (uint64_t)(uint32_t)b;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// 地形の分のハッシュ
+uint64_t map_hash(const BattleState& state) {
+	const TileMap& map = state.map;
+	uint64_t key = zobrist(KeyKind::Size, map.width(), map.height());
+	for (int y = 0; y < map.height(); ++y) {
+		for (int x = 0; x < map.width(); ++x) key ^= zobrist(KeyKind::Tile, map.index(x, y), map.at(x, y));
+	}
+	return key;
+}
+
+// ユニット1体の分のハッシュ(倒れたユニットは位置とhpによらない)
+uint64_t unit_key(const BattleState& state, int i) {
+	const UnitTable& u = state.units;
+	if (u.hp[i] <= 0) return zobrist(KeyKind::Dead, i, 0);
+	uint64_t key = zobrist(KeyKind::Position, i, state.map.index(u.x[i], u.y[i])) ^ zobrist(KeyKind::Hp, i, u.hp[i]);
+	if (u.has_moved[i] || u.has_attacked[i]) key ^= zobrist(KeyKind::Acted, i, 0);
+	return key;
+}
+
+// 命中・会心の判定が要るユニットがいるか(倒れたユニットも含めるので、戦闘中は変わらない)
+bool has_rolls(const BattleState& state) {
+	const UnitTable& u = state.units;
+	for (int i = 0; i < u.size(); ++i) {
+		if (u.hit[i] < 100 || u.crit[i] > 0) return true;
+	}
+	return false;
+}
+
+// 乱数の状態の分のハッシュ(判定の結果は鍵とカウンタで決まるので、同じ盤面でも乱数の続きが違えば別の局面)
+uint64_t rng_key(const CombatRng& rng) {
+	return zobrist(KeyKind::Rng, (int)(rng.key >> 32), (int)rng.key) ^ zobrist(KeyKind::Rng, -1, (int)rng.counter) ^
+		zobrist(KeyKind::Rng, -2, (int)(rng.counter >> 32));
+}
+
+// 地形以外の分のハッシュ(判定が要るユニットがいれば乱数の状態も含む)
+uint64_t units_hash(const BattleState& state) {
+	uint64_t key = state.current_phase == EnemyTurn ? zobrist(KeyKind::Side, 0, 0) : 0;
+	for (int i = 0; i < state.units.size(); ++i) key ^= unit_key(state, i);
+	if (has_rolls(state)) key ^= rng_key(state.rng);
+	return key;
+}
+
+// 手番の陣営で次に行動するユニット(全員行動済みなら-1)
+int next_actor(const BattleState& state) {
+	const UnitTable& u = state.units;
+	for (int i : state.factions.live(state.current_phase == EnemyTurn)) {
+		if (!u.has_moved[i] && !u.has_attacked[i]) return i;
+	}
+	return -1;
+}
+
+// 敵から見た盤面の評価
+int evaluate(const BattleState& state) {
+	const UnitTable& u = state.units;
+	int score = 0;
+	for (int i = 0; i < u.size(); ++i) {
+		if (u.hp[i] <= 0) continue;
+		int value = u.hp[i] + kAliveValue;
+		score += u.is_enemy[i] ? value : -value;
+	}
+	return score;
+}
+
+// 勝敗確定の評価値は置換表には根からの手数を除いて入れる
+int to_table(int value, int ply) {
+	if (value > kWinThreshold) return value + ply;
+	if (value < -kWinThreshold) return value - ply;
+	return value;
+}
+
+int from_table(int value, int ply) {
+	if (value > kWinThreshold) return value - ply;
+	if (value < -kWinThreshold) return value + ply;
+	return value;
+}
+
+} // namespace
+
+SkirmishSearch::SkirmishSearch(const SkirmishConfig& config)
+	: config_(config) {
+	config_.max_depth = std::max(config_.max_depth, 1);
+	config_.max_actions = std::max(config_.max_actions, 1);
+	config_.table_bits = std::clamp(config_.table_bits, 4, 26);
+	table_.resize((size_t)1 << config_.table_bits);
+}
+
+void SkirmishSearch::clear() {
+	std::fill(table_.begin(), table_.end(), TableEntry());
+}
+
+uint64_t SkirmishSearch::hash(const BattleState& state) const {
+	return map_hash(state) ^ units_hash(state);
+}
+
+SkirmishResult SkirmishSearch::search(const BattleState& state) {
+	SkirmishResult result;
+	if (get_battle_result(state) != BattleResult::Ongoing || next_actor(state) < 0) return result;
+
+	// 根の盤面は戦闘ログと移動範囲のキャッシュを空にして写す(深さごとのコピーを軽くする)
+	stack_.resize(config_.max_depth + 1);
+	actions_.resize(config_.max_depth + 1);
+	stack_[0] = state;
+	stack_[0].combat_log.clear();
+	stack_[0].move_cache = MoveRangeCache();
+	stack_[0].rng = state.rng.split(kSearchRngStream);
+
+	map_key_ = map_hash(state);
+	rolls_ = has_rolls(state);
+	const uint64_t key = map_key_ ^ units_hash(stack_[0]);
+	nodes_ = 0;
+	aborted_ = false;
+	has_deadline_ = config_.time_budget_ms > 0.0;
+	deadline_ = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double, std::milli>(config_.time_budget_ms));
+
+	// 反復深化(打ち切られたら1つ前の深さの結果を使う)
+	for (int depth = 1; depth <= config_.max_depth; ++depth) {
+		abortable_ = depth > 1;
+		int value = search_node(0, depth, -kSkirmishWin - 1, kSkirmishWin + 1, key);
+		if (aborted_) break;
+		result.action = root_best_;
+		result.value = value;
+		result.depth = depth;
+		if (std::abs(value) > kWinThreshold) break; // 勝敗まで読み切った
+	}
+	result.nodes = nodes_;
+	return result;
+}
+
+int SkirmishSearch::search_node(int ply, int depth, int alpha, int beta, uint64_t key) {
+	const BattleState& state = stack_[ply];
+	++nodes_;
+	if (abortable_ && (nodes_ & 255) == 0) {
+		if ((has_deadline_ && Clock::now() >= deadline_) || (cancel_ && cancel_->load(std::memory_order_relaxed))) aborted_ = true;
+	}
+	if (aborted_) return 0;
+
+	BattleResult battle_result = get_battle_result(state);
+	if (battle_result == BattleResult::EnemyWin) return kSkirmishWin - ply;
+	if (battle_result == BattleResult::PlayerWin) return -(kSkirmishWin - ply);
+	if (depth <= 0) return evaluate(state);
+
+	// 置換表(根では最善の行動を必ず求めるので値は使わず、行動の順番だけ使う)
+	TableEntry& entry = table_[key & (table_.size() - 1)];
+	int first = 0;
+	if (entry.key == key) {
+		if (entry.best >= 0) first = entry.best;
+		if (ply > 0 && entry.depth >= depth) {
+			int value = from_table(entry.value, ply);
+			if (entry.bound == Exact) return value;
+			if (entry.bound == Lower) alpha = std::max(alpha, value);
+			else beta = std::min(beta, value);
+			if (alpha >= beta) return value;
+		}
+	}
+
+	const int actor = next_actor(state);
+	std::vector<EnemyPlan>& actions = actions_[ply];
+	enumerate_unit_actions(state, actor, scratch_, config_.max_actions, actions);
+	if (actions.empty()) return evaluate(state);
+	const int count = (int)actions.size();
+	if (first >= count) first = 0;
+
+	const bool maximize = state.units.is_enemy[actor] != 0;
+	const int alpha0 = alpha;
+	const int beta0 = beta;
+	int best = maximize ? -kSkirmishWin - 1 : kSkirmishWin + 1;
+	int best_i = first;
+	for (int n = 0; n < count; ++n) {
+		// 前回最善だった行動から調べる
+		const int i = n == 0 ? first : (n <= first ? n - 1 : n);
+		const EnemyPlan& plan = actions[i];
+
+		BattleState& child = stack_[ply + 1];
+		child = state;
+		uint64_t child_key = key ^ unit_key(state, actor);
+		if (plan.attack_target >= 0) child_key ^= unit_key(state, plan.attack_target);
+		apply_enemy_plan(child, plan);
+		child.units.has_moved[actor] = 1;
+		child_key ^= unit_key(child, actor);
+		if (plan.attack_target >= 0) child_key ^= unit_key(child, plan.attack_target);
+		if (rolls_ && child.rng.counter != state.rng.counter) child_key ^= rng_key(state.rng) ^ rng_key(child.rng);
+
+		// 陣営の全員が行動したらターンを交代する
+		if (next_actor(child) < 0) {
+			if (child.current_phase == EnemyTurn) end_enemy_turn(child);
+			else end_player_turn(child);
+			child_key = map_key_ ^ units_hash(child);
+		}
+
+		int value = search_node(ply + 1, depth - 1, alpha, beta, child_key);
+		if (aborted_) return 0;
+		if (maximize ? value > best : value < best) {
+			best = value;
+			best_i = i;
+		}
+		if (maximize) alpha = std::max(alpha, value);
+		else beta = std::min(beta, value);
+		if (alpha >= beta) break;
+	}
+
+	if (ply == 0) root_best_ = actions[best_i];
+	entry.key = key;
+	entry.value = to_table(best, ply);
+	entry.depth = (int16_t)depth;
+	entry.bound = best <= alpha0 ? Upper : (best >= beta0 ? Lower : Exact);
+	entry.best = (int8_t)best_i;
+	return best;
+}
+
+bool is_small_skirmish(const BattleState& state, const SkirmishConfig& config) {
+	return (int)(state.factions.live(false).size() + state.factions.live(true).size()) <= config.max_units;
+}
+
+void skirmish_enemy_turn(BattleState& state, const SkirmishConfig& config, EnemyTurnProgress* progress, std::vector<EnemyPlan>* committed) {
+	const std::vector<int> enemies = state.factions.live(true);
+	auto cancelled = [&] { return progress && progress->cancel.load(std::memory_order_relaxed); };
+	if (progress) {
+		progress->done = 0;
+		progress->total = (int)enemies.size();
+	}
+	if (committed) committed->clear();
+
+	SkirmishSearch search(config);
+	if (progress) search.set_cancel(&progress->cancel);
+	EnemyPlanScratch scratch;
+	state.current_phase = EnemyTurn;
+	for (size_t k = 0; k < enemies.size(); ++k) {
+		if (cancelled()) return;
+		if (progress) progress->done = (int)k;
+		int ei = enemies[k];
+		if (state.units.hp[ei] <= 0) continue;
+
+		// 探索の手番はインデックス順なので、次に行動するのはこの敵になる(勝敗が決まっていれば貪欲AIに任せる)
+		EnemyPlan plan = search.search(state).action;
+		if (plan.unit != ei) plan = plan_enemy_action(state, ei, scratch, false);
+		apply_enemy_plan(state, plan);
+		state.units.has_moved[ei] = 1;
+		if (committed) committed->push_back(plan);
+	}
+	if (cancelled()) return;
+	if (progress) progress->done = (int)enemies.size();
+	end_enemy_turn(state);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 少人数の戦闘(終盤)向けのアルファベータ探索
+/// ユニット1体の行動(移動+攻撃)を1手とし、手番の陣営のまだ行動していないユニットをインデックス順に動かす
+/// 陣営の全員が行動したらターンを交代するので、プレイヤーターンとエネミーターンをまたいで読める
+/// 盤面はZobristハッシュで識別し、置換表は反復深化の各段と同じターン内の次の手の探索で使い回す
+/// 命中・会心の判定が要るユニットがいれば、乱数の状態(鍵とカウンタ)もハッシュに含めて、乱数の続きが違う局面の値を使わない
+/// 命中と会心は確率の分岐を作らず、実際の戦闘とは別の乱数の流れで1通りに決めて読む
+///----------------------------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "srpg/Battle.h"
+
+struct SkirmishConfig {
+	double time_budget_ms = 50.0; // 1手を決めるのに使う時間(0以下なら深さの上限まで読む。最初の深さは必ず読み切る)
+	int max_depth = 12;           // 読む手数の上限
+	int max_actions = 6;          // 1体あたりの行動候補の上限
+	int max_units = 6;            // この探索を使う生存ユニット数の上限(is_small_skirmishの判定用)
+	int table_bits = 18;          // 置換表のエントリ数(2のtable_bits乗)
+};
+
+// 探索の結果
+struct SkirmishResult {
+	EnemyPlan action;   // 次に行動するユニットの最善の行動(行動できるユニットがいなければunitが-1)
+	int value = 0;      // 敵から見た評価値(勝ち確定ならkSkirmishWinに近い値)
+	int depth = 0;      // 読み切った深さ
+	uint64_t nodes = 0; // 調べた局面の数
+};
+
+constexpr int kSkirmishWin = 1000000; // 全滅させた局面の評価値(早く勝つほど大きい)
+
+class SkirmishSearch {
+public:
+	explicit SkirmishSearch(const SkirmishConfig& config = SkirmishConfig());
+
+	// stateの手番(current_phase)の陣営で、次に行動するユニットの行動を探す
+	SkirmishResult search(const BattleState& state);
+
+	// 置換表を空にする(別の戦闘に使う前に呼ばなくてもよいが、古いエントリが場所を取らなくなる)
+	void clear();
+
+	// 立ったら探索を打ち切るフラグ(打ち切った場合はそこまでに読み切った深さの結果を返す)
+	void set_cancel(const std::atomic<bool>* cancel) { cancel_ = cancel; }
+
+	// 盤面(地形・ユニットの位置/hp/行動済みかどうか・手番、判定が要るユニットがいれば乱数の状態)のZobristハッシュ
+	uint64_t hash(const BattleState& state) const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// 置換表のエントリ
+	struct TableEntry {
+		uint64_t key = 0;
+		int value = 0;
+		int16_t depth = -1;
+		uint8_t bound = 0;     // Exact/Lower/Upper
+		int8_t best = -1;      // 最善だった行動の候補内の位置
+	};
+
+	int search_node(int ply, int depth, int alpha, int beta, uint64_t key);
+
+	SkirmishConfig config_;
+	std::vector<TableEntry> table_;
+	uint64_t map_key_ = 0; // 地形の分のハッシュ(探索中は変わらない)
+	bool rolls_ = false;   // 判定が要るユニットがいるか(いればハッシュに乱数の状態を含める)
+
+	std::vector<BattleState> stack_;              // 深さごとの盤面(コピー先の領域を使い回す)
+	std::vector<std::vector<EnemyPlan>> actions_; // 深さごとの行動候補
+	EnemyPlanScratch scratch_;
+	EnemyPlan root_best_;
+	uint64_t nodes_ = 0;
+	bool abortable_ = false;
+	bool aborted_ = false;
+	bool has_deadline_ = false;
+	Clock::time_point deadline_;
+	const std::atomic<bool>* cancel_ = nullptr;
+};
+
+// 生存ユニットがconfig.max_units以下で、この探索を使える戦闘かどうか
+bool is_small_skirmish(const BattleState& state, const SkirmishConfig& config);
+
+// アルファベータ探索でエネミーターンを実行する関数(引数の意味はenemy_turn_logicと同じ)
+// 敵を1体ずつ、config.time_budget_msずつ使って探索する
+void skirmish_enemy_turn(BattleState& state, const SkirmishConfig& config,
+	EnemyTurnProgress* progress = nullptr, std::vector<EnemyPlan>* committed = nullptr);
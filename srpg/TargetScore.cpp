@@ -0,0 +1,156 @@
+#include "srpg/TargetScore.h"
+
+#include <cstdlib>
+
+#if !defined(SRPG_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define SRPG_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clangでは関数単位でAVX2を有効にする(MSVCは指定なしで組み込み関数を使える)
+#if defined(SRPG_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SRPG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SRPG_TARGET_AVX2
+#endif
+
+namespace {
+
+// 候補マス[begin, end)を1マスずつ評価する
+void score_scalar(TargetScoreBatch& b, int begin, int end, int min_range, int max_range) {
+	const int targets = b.target_count();
+	for (int c = begin; c < end; ++c) {
+		int best_damage = -1;
+		int best_target = -1;
+		for (int t = 0; t < targets; ++t) {
+			int dist = std::abs(b.tile_x[c] - b.target_x[t]) + std::abs(b.tile_y[c] - b.target_y[t]);
+			if (dist >= min_range && dist <= max_range && b.target_damage[t] > best_damage) {
+				best_damage = b.target_damage[t];
+				best_target = b.target[t];
+			}
+		}
+		b.best_damage[c] = best_damage;
+		b.best_target[c] = best_target;
+	}
+}
+
+#if defined(SRPG_SIMD_X86)
+
+// SSE2で4マスずつ評価する(SSE2にはabsとblendがないので論理演算で組み立てる)
+void score_sse2(TargetScoreBatch& b, int min_range, int max_range) {
+	const int tiles = b.tile_count();
+	const int targets = b.target_count();
+	const __m128i lo = _mm_set1_epi32(min_range - 1);
+	const __m128i hi = _mm_set1_epi32(max_range + 1);
+	auto abs_epi32 = [](__m128i v) {
+		__m128i sign = _mm_srai_epi32(v, 31);
+		return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+	};
+	auto select = [](__m128i mask, __m128i a, __m128i b) { // maskが立っていればa
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	};
+
+	int c = 0;
+	for (; c + 4 <= tiles; c += 4) {
+		const __m128i cx = _mm_loadu_si128((const __m128i*)&b.tile_x[c]);
+		const __m128i cy = _mm_loadu_si128((const __m128i*)&b.tile_y[c]);
+		__m128i best_damage = _mm_set1_epi32(-1);
+		__m128i best_target = _mm_set1_epi32(-1);
+		for (int t = 0; t < targets; ++t) {
+			__m128i dx = abs_epi32(_mm_sub_epi32(cx, _mm_set1_epi32(b.target_x[t])));
+			__m128i dy = abs_epi32(_mm_sub_epi32(cy, _mm_set1_epi32(b.target_y[t])));
+			__m128i dist = _mm_add_epi32(dx, dy);
+			__m128i damage = _mm_set1_epi32(b.target_damage[t]);
+			__m128i better = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(dist, lo), _mm_cmplt_epi32(dist, hi)),
+				_mm_cmpgt_epi32(damage, best_damage));
+			best_damage = select(better, damage, best_damage);
+			best_target = select(better, _mm_set1_epi32(b.target[t]), best_target);
+		}
+		_mm_storeu_si128((__m128i*)&b.best_damage[c], best_damage);
+		_mm_storeu_si128((__m128i*)&b.best_target[c], best_target);
+	}
+	score_scalar(b, c, tiles, min_range, max_range);
+}
+
+// AVX2で8マスずつ評価する
+SRPG_TARGET_AVX2 void score_avx2(TargetScoreBatch& b, int min_range, int max_range) {
+	const int tiles = b.tile_count();
+	const int targets = b.target_count();
+	const __m256i lo = _mm256_set1_epi32(min_range - 1);
+	const __m256i hi = _mm256_set1_epi32(max_range + 1);
+
+	int c = 0;
+	for (; c + 8 <= tiles; c += 8) {
+		const __m256i cx = _mm256_loadu_si256((const __m256i*)&b.tile_x[c]);
+		const __m256i cy = _mm256_loadu_si256((const __m256i*)&b.tile_y[c]);
+		__m256i best_damage = _mm256_set1_epi32(-1);
+		__m256i best_target = _mm256_set1_epi32(-1);
+		for (int t = 0; t < targets; ++t) {
+			__m256i dx = _mm256_abs_epi32(_mm256_sub_epi32(cx, _mm256_set1_epi32(b.target_x[t])));
+			__m256i dy = _mm256_abs_epi32(_mm256_sub_epi32(cy, _mm256_set1_epi32(b.target_y[t])));
+			__m256i dist = _mm256_add_epi32(dx, dy);
+			__m256i damage = _mm256_set1_epi32(b.target_damage[t]);
+			__m256i better = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(dist, lo), _mm256_cmpgt_epi32(hi, dist)),
+				_mm256_cmpgt_epi32(damage, best_damage));
+			best_damage = _mm256_blendv_epi8(best_damage, damage, better);
+			best_target = _mm256_blendv_epi8(best_target, _mm256_set1_epi32(b.target[t]), better);
+		}
+		_mm256_storeu_si256((__m256i*)&b.best_damage[c], best_damage);
+		_mm256_storeu_si256((__m256i*)&b.best_target[c], best_target);
+	}
+	score_scalar(b, c, tiles, min_range, max_range);
+}
+
+bool cpu_has_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false; // OSがYMMレジスタを保存するか
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // SRPG_SIMD_X86
+
+} // namespace
+
+ScoreKernel detect_score_kernel() {
+#if defined(SRPG_SIMD_X86)
+	static const ScoreKernel kernel = cpu_has_avx2() ? ScoreKernel::AVX2 : ScoreKernel::SSE2;
+	return kernel;
+#else
+	return ScoreKernel::Scalar;
+#endif
+}
+
+void score_targets(TargetScoreBatch& batch, int min_range, int max_range) {
+	score_targets(batch, min_range, max_range, detect_score_kernel());
+}
+
+void score_targets(TargetScoreBatch& batch, int min_range, int max_range, ScoreKernel kernel) {
+	batch.best_damage.resize(batch.tile_count());
+	batch.best_target.resize(batch.tile_count());
+
+#if defined(SRPG_SIMD_X86)
+	ScoreKernel available = detect_score_kernel();
+	if (kernel == ScoreKernel::AVX2 && available == ScoreKernel::AVX2) {
+		score_avx2(batch, min_range, max_range);
+		return;
+	}
+	if (kernel != ScoreKernel::Scalar) {
+		score_sse2(batch, min_range, max_range);
+		return;
+	}
+#else
+	(void)kernel;
+#endif
+	score_scalar(batch, 0, batch.tile_count(), min_range, max_range);
+}
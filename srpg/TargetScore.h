@@ -0,0 +1,62 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 移動先の候補マスと攻撃対象の組をまとめて評価するカーネル
+/// 候補マスを8個(AVX2)/4個(SSE2)ずつ並べ、対象1体ずつとの距離判定とダメージ比較を同時に行う
+/// 使える命令セットは実行時に判定し、x86-64以外やSRPG_NO_SIMDを定義したビルドではスカラー版を使う
+///----------------------------------------------------------------------------
+
+#include <vector>
+
+// カーネルの実装
+enum class ScoreKernel {
+	Scalar, // 1組ずつ
+	SSE2,   // 4マスずつ
+	AVX2    // 8マスずつ
+};
+
+// 評価の入出力(フィールドごとの配列)
+struct TargetScoreBatch {
+	// 候補マス
+	std::vector<int> tile_x;
+	std::vector<int> tile_y;
+	// 攻撃対象(targetの昇順に追加すること)
+	std::vector<int> target_x;
+	std::vector<int> target_y;
+	std::vector<int> target_damage; // 対象に与えるダメージ(0以上)
+	std::vector<int> target;        // 対象のユニットのインデックス
+	// 結果(候補マスごとに、射程内で最もダメージの大きい対象。同じダメージなら先に追加した対象)
+	std::vector<int> best_damage;   // 射程内に対象がいなければ-1
+	std::vector<int> best_target;   // 射程内に対象がいなければ-1
+
+	int tile_count() const { return (int)tile_x.size(); }
+	int target_count() const { return (int)target_x.size(); }
+
+	void clear() {
+		tile_x.clear();
+		tile_y.clear();
+		target_x.clear();
+		target_y.clear();
+		target_damage.clear();
+		target.clear();
+	}
+	void add_tile(int x, int y) {
+		tile_x.push_back(x);
+		tile_y.push_back(y);
+	}
+	void add_target(int x, int y, int damage, int index) {
+		target_x.push_back(x);
+		target_y.push_back(y);
+		target_damage.push_back(damage);
+		target.push_back(index);
+	}
+};
+
+// この環境で使える最も速いカーネル(初回の呼び出しで判定する)
+ScoreKernel detect_score_kernel();
+
+// 候補マスごとに、マンハッタン距離がmin_range以上max_range以下の対象のうち最良のものを求める
+void score_targets(TargetScoreBatch& batch, int min_range, int max_range);
+
+// カーネルを指定して評価する(この環境で使えないカーネルを指定した場合は使えるものに落とす)
+void score_targets(TargetScoreBatch& batch, int min_range, int max_range, ScoreKernel kernel);
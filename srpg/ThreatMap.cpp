@@ -0,0 +1,61 @@
+#include "srpg/ThreatMap.h"
+
+#include <algorithm>
+
+#include "srpg/Battle.h"
+
+void compute_threat_map(const BattleState& state, bool from_enemy, ThreatMap& out) {
+	const TileGrid& grid = state.map.grid();
+	if (!(out.grid == grid) || (int)out.count.size() != grid.tile_count()) {
+		out.grid = grid;
+		out.count.assign(grid.tile_count(), 0);
+		out.max_atk.assign(grid.tile_count(), 0);
+		out.max_crit_atk.assign(grid.tile_count(), -1);
+		out.stamp_.assign(grid.tile_count(), -1);
+	} else {
+		std::fill(out.count.begin(), out.count.end(), (uint16_t)0);
+		std::fill(out.max_atk.begin(), out.max_atk.end(), 0);
+		std::fill(out.max_crit_atk.begin(), out.max_crit_atk.end(), -1);
+		std::fill(out.stamp_.begin(), out.stamp_.end(), -1);
+	}
+	out.from_enemy = from_enemy;
+	out.revision = state.revision;
+
+	const UnitTable& units = state.units;
+	for (int ui : state.factions.live(from_enemy)) {
+		const int marker = ui;
+		const WeaponType weapon = units.weapon[ui];
+		const int atk = units.atk[ui];
+		const bool can_crit = units.crit[ui] > 0;
+
+		for (int move_tile : get_cached_move_range(state, marker)) {
+			// 他のユニットがいるマスでは行動を終えられない
+			int occupant = state.occupancy[move_tile] - 1;
+			if (occupant != NO_UNIT && occupant != marker) continue;
+
+			for_each_attack_tile(state, weapon, grid.x_of(move_tile), grid.y_of(move_tile), [&](int tx, int ty) {
+				int i = grid.index(tx, ty);
+				if (out.stamp_[i] == marker) return;
+				out.stamp_[i] = marker;
+				++out.count[i];
+				out.max_atk[i] = std::max(out.max_atk[i], atk);
+				if (can_crit) out.max_crit_atk[i] = std::max(out.max_crit_atk[i], atk);
+			});
+		}
+	}
+}
+
+int ThreatMap::max_damage_at(int x, int y, int def) const {
+	if (!grid.contains(x, y)) return -1;
+	int i = grid.index(x, y);
+	if (count[i] == 0) return -1;
+	int damage = strike_damage(max_atk[i], def, false);
+	if (max_crit_atk[i] >= 0) damage = std::max(damage, strike_damage(max_crit_atk[i], def, true));
+	return damage;
+}
+
+bool update_threat_map(const BattleState& state, bool from_enemy, ThreatMap& map) {
+	if (map.revision == state.revision && map.from_enemy == from_enemy && map.grid == state.map.grid()) return false;
+	compute_threat_map(state, from_enemy, map);
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 脅威マップ(次のターンに陣営全体から攻撃されうるマス)
+///----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <vector>
+
+#include "srpg/TileMap.h"
+
+struct BattleState;
+
+struct ThreatMap {
+	TileGrid grid;
+	std::vector<uint16_t> count;   // マスを攻撃できるユニット数(マス番号順)
+	std::vector<int> max_atk;      // マスを攻撃できるユニットの最大攻撃力(マス番号順)
+	std::vector<int> max_crit_atk; // そのうち会心の一撃を出しうる(会心率が0より大きい)ユニットの最大攻撃力(いなければ-1)
+	bool from_enemy = true;        // どちらの陣営からの脅威か
+	uint64_t revision = ~0ull;     // 計算したときのBattleState::revision
+
+	int count_at(int x, int y) const {
+		return grid.contains(x, y) ? count[grid.index(x, y)] : 0;
+	}
+	// 防御力defのユニットがマスで受けうる1回の最大ダメージ(会心の一撃も含む。攻撃されなければ-1)
+	int max_damage_at(int x, int y, int def) const;
+
+private:
+	friend void compute_threat_map(const BattleState& state, bool from_enemy, ThreatMap& out);
+	std::vector<int> stamp_;       // マスを最後に数えたユニット(同じユニットを重複して数えないため)
+};
+
+// 陣営の全ユニットについて「移動範囲 + 攻撃ステンシル」を1回の走査で重ね合わせる関数
+// 移動範囲はキャッシュを使うので、動いていないユニットの分は計算し直さない
+void compute_threat_map(const BattleState& state, bool from_enemy, ThreatMap& out);
+
+// 盤面が変わっていたときだけ脅威マップを計算し直す関数(計算し直したらtrueを返す)
+bool update_threat_map(const BattleState& state, bool from_enemy, ThreatMap& map);
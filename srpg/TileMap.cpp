@@ -0,0 +1,30 @@
+#include "srpg/TileMap.h"
+
+#include <string>
+#include <utility>
+
+bool load_tile_map(std::istream& in, TileMap& out, TileLayout layout) {
+	std::vector<std::string> rows;
+	std::string line;
+	while (std::getline(in, line)) {
+		std::string row;
+		for (char c : line) {
+			if (c == ' ' || c == '\t' || c == '\r' || c == ',') continue;
+			if (c < '0' || c - '0' >= TILE_TYPE_COUNT) return false;
+			row.push_back(c);
+		}
+		if (row.empty()) continue; // 空行は読み飛ばす
+		if (!rows.empty() && row.size() != rows.front().size()) return false;
+		rows.push_back(std::move(row));
+	}
+	if (rows.empty()) return false;
+
+	TileMap map((int)rows.front().size(), (int)rows.size(), layout);
+	for (int y = 0; y < map.height(); ++y) {
+		for (int x = 0; x < map.width(); ++x) {
+			map.set(x, y, (uint8_t)(rows[y][x] - '0'));
+		}
+	}
+	out = std::move(map);
+	return true;
+}
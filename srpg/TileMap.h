@@ -0,0 +1,158 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 実行時にサイズを決められるマップと、マス単位の集合
+///----------------------------------------------------------------------------
+
+#include <bit>
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+// マスの並び順
+enum class TileLayout {
+	RowMajor, // 行優先(小さいマップ向け)
+	Blocked   // 8x8のブロック単位(大きいマップでも近傍のマスが同じキャッシュラインに乗る)
+};
+
+// マップの形状(座標とマス番号の変換)
+// マス単位の配列(地形、占有、移動範囲など)はすべてこの番号で並べる
+struct TileGrid {
+	static constexpr int kBlockShift = 3;                 // ブロックの一辺(2の累乗)
+	static constexpr int kBlockSize = 1 << kBlockShift;   // 8
+	static constexpr int kBlockMask = kBlockSize - 1;
+	static constexpr int kBlockTiles = kBlockSize * kBlockSize; // 64マス = 地形1バイトなら1キャッシュライン
+
+	int width = 0;
+	int height = 0;
+	TileLayout layout = TileLayout::RowMajor;
+	int blocks_x = 0; // 横方向のブロック数(Blockedのみ)
+	int blocks_y = 0; // 縦方向のブロック数(Blockedのみ)
+
+	TileGrid() = default;
+	TileGrid(int w, int h, TileLayout l)
+		: width(w), height(h), layout(l),
+		blocks_x((w + kBlockMask) >> kBlockShift), blocks_y((h + kBlockMask) >> kBlockShift) {
+	}
+
+	// マス単位の配列に必要な要素数(Blockedではブロック境界までのパディングを含む)
+	int tile_count() const {
+		return layout == TileLayout::Blocked ? blocks_x * blocks_y * kBlockTiles : width * height;
+	}
+
+	bool contains(int x, int y) const {
+		return x >= 0 && y >= 0 && x < width && y < height;
+	}
+
+	// 座標からマス番号へ
+	int index(int x, int y) const {
+		if (layout == TileLayout::RowMajor) return y * width + x;
+		int block = (y >> kBlockShift) * blocks_x + (x >> kBlockShift);
+		return (block << (2 * kBlockShift)) | ((y & kBlockMask) << kBlockShift) | (x & kBlockMask);
+	}
+	// マス番号から座標へ
+	int x_of(int i) const {
+		if (layout == TileLayout::RowMajor) return i % width;
+		return ((i >> (2 * kBlockShift)) % blocks_x << kBlockShift) | (i & kBlockMask);
+	}
+	int y_of(int i) const {
+		if (layout == TileLayout::RowMajor) return i / width;
+		return ((i >> (2 * kBlockShift)) / blocks_x << kBlockShift) | ((i >> kBlockShift) & kBlockMask);
+	}
+
+	bool operator==(const TileGrid& other) const = default;
+};
+
+// タイルの種類
+enum TileType {
+	PLAIN = 0,  // 平地
+	FOREST = 1, // 森
+	HILL = 2,   // 丘
+	WATER = 3,  // 水辺
+	TILE_TYPE_COUNT
+};
+
+// 地形マップ(1マス1バイトのTileType)
+class TileMap {
+public:
+	TileMap() = default;
+	TileMap(int width, int height, TileLayout layout = TileLayout::RowMajor)
+		: grid_(width, height, layout), tiles_(grid_.tile_count(), 0) {
+	}
+
+	const TileGrid& grid() const { return grid_; }
+	int width() const { return grid_.width; }
+	int height() const { return grid_.height; }
+
+	bool contains(int x, int y) const { return grid_.contains(x, y); }
+	int index(int x, int y) const { return grid_.index(x, y); }
+
+	uint8_t at(int x, int y) const { return tiles_[grid_.index(x, y)]; }
+	uint8_t at_index(int i) const { return tiles_[i]; }
+	void set(int x, int y, uint8_t tile) { tiles_[grid_.index(x, y)] = tile; }
+
+private:
+	TileGrid grid_;
+	std::vector<uint8_t> tiles_;
+};
+
+// マスの集合(1マス1ビット、並びはTileGridのマス番号順)
+class TileSet {
+public:
+	TileSet() = default;
+	explicit TileSet(const TileGrid& grid) { reset(grid); }
+
+	// 形状を合わせて空にする(同じ形状なら再確保しない)
+	void reset(const TileGrid& grid) {
+		grid_ = grid;
+		words_.assign((grid.tile_count() + 63) / 64, 0);
+	}
+
+	const TileGrid& grid() const { return grid_; }
+
+	// マスが含まれているかどうか(マップ外ならfalse)
+	bool contains(int x, int y) const {
+		if (!grid_.contains(x, y)) return false;
+		return test(grid_.index(x, y));
+	}
+	bool test(int i) const {
+		return (words_[i >> 6] >> (i & 63)) & 1;
+	}
+	// マスを追加する(マップ内のマスのみ)
+	void insert(int x, int y) { set(grid_.index(x, y)); }
+	void set(int i) {
+		words_[i >> 6] |= uint64_t(1) << (i & 63);
+	}
+	void clear() {
+		for (auto& w : words_) w = 0;
+	}
+	bool empty() const {
+		for (auto w : words_) if (w) return false;
+		return true;
+	}
+	int size() const {
+		int n = 0;
+		for (auto w : words_) n += std::popcount(w);
+		return n;
+	}
+	// 含まれているマスをマス番号の順番で列挙する
+	template <class Func>
+	void for_each(Func&& func) const {
+		for (size_t wi = 0; wi < words_.size(); ++wi) {
+			uint64_t w = words_[wi];
+			while (w) {
+				int i = (int)wi * 64 + std::countr_zero(w);
+				func(grid_.x_of(i), grid_.y_of(i));
+				w &= w - 1;
+			}
+		}
+	}
+
+private:
+	TileGrid grid_;
+	std::vector<uint64_t> words_;
+};
+
+// テキストからマップを読み込む関数
+// 1行がマップの1行分で、各文字がTileTypeの数字(空白は読み飛ばす)。行の長さが揃っていないか、TileTypeにない数字があればfalseを返す
+bool load_tile_map(std::istream& in, TileMap& out, TileLayout layout = TileLayout::RowMajor);
@@ -0,0 +1,94 @@
+#include "srpg/Unit.h"
+
+uint32_t NameTable::intern(std::string_view name) {
+	auto it = ids_.find(name);
+	if (it != ids_.end()) return it->second;
+	uint32_t id = (uint32_t)names_.size();
+	names_.emplace_back(name);
+	ids_.emplace(names_.back(), id);
+	return id;
+}
+
+bool NameTable::find(std::string_view name, uint32_t& id) const {
+	auto it = ids_.find(name);
+	if (it == ids_.end()) return false;
+	id = it->second;
+	return true;
+}
+
+int UnitTable::add(const Unit& unit) {
+	x.push_back(unit.x);
+	y.push_back(unit.y);
+	hp.push_back(unit.hp);
+	is_enemy.push_back(unit.is_enemy ? 1 : 0);
+	move.push_back(unit.move);
+	atk.push_back(unit.atk);
+	def.push_back(unit.def);
+	weapon.push_back(unit.weapon);
+	move_class.push_back(unit.move_class);
+	hit.push_back(unit.hit);
+	crit.push_back(unit.crit);
+	has_moved.push_back(unit.has_moved ? 1 : 0);
+	has_attacked.push_back(unit.has_attacked ? 1 : 0);
+	uint32_t id;
+	if (!names->find(unit.name, id)) {
+		// 他の写しと共有している表は書き換えずに複製する
+		if (names.use_count() > 1) names = std::make_shared<NameTable>(*names);
+		id = names->intern(unit.name);
+	}
+	name_id.push_back(id);
+	return size() - 1;
+}
+
+void UnitTable::reserve(int count) {
+	x.reserve(count);
+	y.reserve(count);
+	hp.reserve(count);
+	is_enemy.reserve(count);
+	move.reserve(count);
+	atk.reserve(count);
+	def.reserve(count);
+	weapon.reserve(count);
+	move_class.reserve(count);
+	hit.reserve(count);
+	crit.reserve(count);
+	has_moved.reserve(count);
+	has_attacked.reserve(count);
+	name_id.reserve(count);
+}
+
+void UnitTable::clear() {
+	x.clear();
+	y.clear();
+	hp.clear();
+	is_enemy.clear();
+	move.clear();
+	atk.clear();
+	def.clear();
+	weapon.clear();
+	move_class.clear();
+	hit.clear();
+	crit.clear();
+	has_moved.clear();
+	has_attacked.clear();
+	name_id.clear();
+}
+
+Unit UnitTable::get(int i) const {
+	Unit u;
+	u.name = name(i);
+	u.x = x[i];
+	u.y = y[i];
+	u.is_enemy = is_enemy[i] != 0;
+	u.hp = hp[i];
+	u.move = move[i];
+	u.has_moved = has_moved[i] != 0;
+	u.has_attacked = has_attacked[i] != 0;
+	u.atk = atk[i];
+	u.def = def[i];
+	u.weapon = weapon[i];
+	u.move_class = move_class[i];
+	u.hit = hit[i];
+	u.crit = crit[i];
+	return u;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// ユニットの定義と、ユニットをフィールドごとの配列で持つテーブル
+/// AIや占有の走査では位置やhpだけを連続したメモリで読めるようにし、名前などの冷たいデータは別に置く
+///----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "srpg/Weapon.h"
+
+// ユニットの移動タイプ(地形ごとの移動コストが変わる)
+enum class MoveClass : uint8_t {
+	Infantry, // 歩兵
+	Cavalry,  // 騎兵
+	Flying,   // 飛行
+	Count
+};
+
+// ユニット情報(配置の指定や、UIに表示するときの1体分の写し)
+struct Unit {
+	std::string name;          // ユニット名
+	int x, y;                  // 位置
+	bool is_enemy;             // 敵かどうか
+	int hp;                    // hp
+	int move = 3;              // 移動力
+	bool has_moved = false;    // 移動済みかどうか
+	bool has_attacked = false; // 攻撃済みかどうか
+	int atk = 5;               // 攻撃力
+	int def = 2;               // 防御力
+
+	WeaponType weapon = WeaponType::Sword; // 武器タイプ
+	MoveClass move_class = MoveClass::Infantry; // 移動タイプ
+	int hit = 100;             // 命中率(%)
+	int crit = 0;              // 会心率(%、会心の一撃はダメージがCRITICAL_MULTIPLIER倍)
+
+	// 最小攻撃範囲
+	int min_range() const {
+		return get_weapon_spec(weapon).min_range;
+	}
+	// 最大攻撃範囲
+	int max_range() const {
+		return get_weapon_spec(weapon).max_range;
+	}
+};
+
+// ユニット名の表(同じ名前には同じIDを振る、追記のみ)
+class NameTable {
+public:
+	uint32_t intern(std::string_view name);
+	bool find(std::string_view name, uint32_t& id) const; // 登録済みならidに入れてtrue
+	const std::string& str(uint32_t id) const { return names_[id]; }
+	int size() const { return (int)names_.size(); }
+
+private:
+	// string_viewのまま引けるハッシュ(検索のたびにstd::stringを作らない)
+	struct NameHash {
+		using is_transparent = void;
+		size_t operator()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+	};
+
+	std::vector<std::string> names_;
+	std::unordered_map<std::string, uint32_t, NameHash, std::equal_to<>> ids_;
+};
+
+// 全ユニット(フィールドごとの配列、添字がユニットのインデックス)
+// 配列は直接読み書きしてよいが、ユニットの追加はaddで行い配列の長さを揃えること
+struct UnitTable {
+	// 走査で毎回読むデータ
+	std::vector<int> x;                // 位置
+	std::vector<int> y;
+	std::vector<int> hp;               // hp(0以下なら倒れている)
+	std::vector<uint8_t> is_enemy;     // 敵かどうか(0/1)
+
+	// 能力値
+	std::vector<int> move;             // 移動力
+	std::vector<int> atk;              // 攻撃力
+	std::vector<int> def;              // 防御力
+	std::vector<WeaponType> weapon;    // 武器タイプ
+	std::vector<MoveClass> move_class; // 移動タイプ
+	std::vector<int> hit;              // 命中率(%)
+	std::vector<int> crit;             // 会心率(%)
+
+	// 行動済みフラグ(0/1)
+	std::vector<uint8_t> has_moved;
+	std::vector<uint8_t> has_attacked;
+
+	// 名前(namesのID)
+	std::vector<uint32_t> name_id;
+	// 名前の表(コピーしたテーブル同士で共有する、追記のみなので既存のIDは変わらない)
+	// 共有中の表には書き込まず、新しい名前を足すときは自分用に複製してから足す(コピーオンライト)
+	// そのため別スレッドのワーカーが写しにユニットを追加しても、元の表を読んでいるスレッドとは競合しない
+	std::shared_ptr<NameTable> names = std::make_shared<NameTable>();
+
+	int size() const { return (int)x.size(); }
+	bool empty() const { return x.empty(); }
+
+	// ユニットを末尾に追加してインデックスを返す
+	int add(const Unit& unit);
+	void reserve(int count);
+	void clear();
+
+	// 1体分の写しを作る(UI表示など、走査以外の用途向け)
+	Unit get(int i) const;
+	const std::string& name(int i) const { return names->str(name_id[i]); }
+
+	bool alive(int i) const { return hp[i] > 0; }
+	int min_range(int i) const { return get_weapon_spec(weapon[i]).min_range; }
+	int max_range(int i) const { return get_weapon_spec(weapon[i]).max_range; }
+};
@@ -0,0 +1,137 @@
+#include "srpg/UnitActions.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// 攻撃できる移動先の候補
+struct AttackOption {
+	int damage;
+	int x, y;
+	int target;
+};
+
+// 重複しなければ候補に加える
+void add_unique(const BattleState& state, std::vector<EnemyPlan>& out, int max_actions, const EnemyPlan& plan) {
+	if ((int)out.size() >= max_actions) return;
+	for (const auto& p : out) {
+		if (same_unit_action(state, p, plan)) return;
+	}
+	out.push_back(plan);
+}
+
+} // namespace
+
+bool same_unit_action(const BattleState& state, const EnemyPlan& a, const EnemyPlan& b) {
+	if (a.unit != b.unit || a.attack_target != b.attack_target) return false;
+	if ((a.target < 0) != (b.target < 0)) return false;
+	int ax = a.moves ? a.move_x : state.units.x[a.unit];
+	int ay = a.moves ? a.move_y : state.units.y[a.unit];
+	int bx = b.moves ? b.move_x : state.units.x[b.unit];
+	int by = b.moves ? b.move_y : state.units.y[b.unit];
+	return ax == bx && ay == by;
+}
+
+void enumerate_unit_actions(const BattleState& state, int unit_index, EnemyPlanScratch& scratch, int max_actions, std::vector<EnemyPlan>& out) {
+	out.clear();
+	const UnitTable& units = state.units;
+	const TileGrid& grid = state.map.grid();
+	const int ui = unit_index;
+	const int ux = units.x[ui];
+	const int uy = units.y[ui];
+	const bool opponent_is_enemy = !units.is_enemy[ui];
+	const int min_r = units.min_range(ui);
+	const int max_r = units.max_range(ui);
+
+	int nearest = state.factions.nearest(units, opponent_is_enemy, ux, uy);
+	if (nearest < 0 || max_actions <= 0) return;
+
+	// 行動を終えられるマスと、届きうる範囲の相手を集めて評価する
+	search_move_range(state, ui, scratch.move);
+	TargetScoreBatch& batch = scratch.batch;
+	batch.clear();
+	for (int tile : scratch.move.reached) {
+		int x = grid.x_of(tile);
+		int y = grid.y_of(tile);
+		int occupant = unit_at(state, x, y);
+		if (occupant != NO_UNIT && occupant != ui) continue;
+		batch.add_tile(x, y);
+	}
+	const int reach = units.move[ui] + max_r;
+	scratch.nearby.clear();
+	state.factions.for_each_near(opponent_is_enemy, ux - reach, uy - reach, ux + reach, uy + reach, [&](int t) { scratch.nearby.push_back(t); });
+	std::sort(scratch.nearby.begin(), scratch.nearby.end());
+	for (int t : scratch.nearby) batch.add_target(units.x[t], units.y[t], std::max(0, units.atk[ui] - units.def[t]), t);
+	score_targets(batch, min_r, max_r);
+
+	EnemyPlan base;
+	base.unit = ui;
+	base.target = nearest;
+	base.move_x = ux;
+	base.move_y = uy;
+
+	// 移動して攻撃(ダメージの大きい順、同じなら行優先。まず対象ごとに1つずつ選んで、残りの枠を埋める)
+	std::vector<AttackOption> options;
+	for (int c = 0; c < batch.tile_count(); ++c) {
+		if (batch.best_damage[c] > 0) options.push_back({ batch.best_damage[c], batch.tile_x[c], batch.tile_y[c], batch.best_target[c] });
+	}
+	std::sort(options.begin(), options.end(), [](const AttackOption& a, const AttackOption& b) {
+		if (a.damage != b.damage) return a.damage > b.damage;
+		if (a.y != b.y) return a.y < b.y;
+		return a.x < b.x;
+	});
+	const int attack_slots = std::max(1, max_actions - 2); // 前進と待機の枠を残す
+	auto attack_plan = [&](const AttackOption& o) {
+		EnemyPlan plan = base;
+		plan.moves = o.x != ux || o.y != uy;
+		plan.move_x = o.x;
+		plan.move_y = o.y;
+		plan.attack_target = o.target;
+		plan.target = o.target;
+		return plan;
+	};
+	std::vector<int> seen_targets;
+	for (const auto& o : options) {
+		if (std::find(seen_targets.begin(), seen_targets.end(), o.target) != seen_targets.end()) continue;
+		seen_targets.push_back(o.target);
+		add_unique(state, out, attack_slots, attack_plan(o));
+	}
+	for (const auto& o : options) add_unique(state, out, attack_slots, attack_plan(o));
+
+	// 最も近い相手に一番近づけるマスへの前進(距離場があれば回り込んだ移動コストで測る)
+	const int nx = units.x[nearest];
+	const int ny = units.y[nearest];
+	const FlowField* flow = scratch.flow && scratch.flow->for_enemy == !opponent_is_enemy ? scratch.flow->get(units.move_class[ui]) : nullptr;
+	if (flow && flow->distance_at(ux, uy) == kFlowUnreachable) flow = nullptr;
+	auto distance_of = [&](int x, int y) {
+		return flow ? flow->distance_at(x, y) : std::abs(x - nx) + std::abs(y - ny);
+	};
+	int best_c = -1;
+	int best_dist = distance_of(ux, uy);
+	for (int c = 0; c < batch.tile_count(); ++c) {
+		int dist = distance_of(batch.tile_x[c], batch.tile_y[c]);
+		if (dist < best_dist || (best_c >= 0 && dist == best_dist &&
+			(batch.tile_y[c] < batch.tile_y[best_c] || (batch.tile_y[c] == batch.tile_y[best_c] && batch.tile_x[c] < batch.tile_x[best_c])))) {
+			best_dist = dist;
+			best_c = c;
+		}
+	}
+	if (best_c >= 0) {
+		EnemyPlan plan = base;
+		plan.moves = true;
+		plan.move_x = batch.tile_x[best_c];
+		plan.move_y = batch.tile_y[best_c];
+		add_unique(state, out, max_actions, plan);
+	}
+
+	// その場で攻撃、攻撃できなければ待機
+	EnemyPlan stay = base;
+	for (int c = 0; c < batch.tile_count(); ++c) {
+		if (batch.tile_x[c] == ux && batch.tile_y[c] == uy && batch.best_damage[c] > 0) {
+			stay.attack_target = batch.best_target[c];
+			stay.target = stay.attack_target;
+		}
+	}
+	add_unique(state, out, max_actions, stay);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 探索AI用の行動候補の列挙
+/// どちらの陣営のユニットにも使える(相手はユニットと反対の陣営)
+///----------------------------------------------------------------------------
+
+#include <vector>
+
+#include "srpg/Battle.h"
+
+// ユニット1体の行動候補を列挙する関数(状態は変えず、移動範囲のキャッシュも使わないので複数スレッドから同時に呼べる)
+// 候補は「移動して攻撃(対象ごとに最もダメージの大きいマスを優先)」「最も近い相手への前進」「その場で攻撃/待機」の順で、
+// 移動先と攻撃対象が同じ行動は1つにまとめ、最大max_actions個まで。相手がいなければ空になる
+void enumerate_unit_actions(const BattleState& state, int unit_index, EnemyPlanScratch& scratch, int max_actions, std::vector<EnemyPlan>& out);
+
+// 2つの行動の結果(行動後の位置と攻撃対象)が同じかどうか
+bool same_unit_action(const BattleState& state, const EnemyPlan& a, const EnemyPlan& b);
@@ -0,0 +1,83 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 武器ごとの射程と攻撃範囲のステンシル
+/// 射程内のマスのオフセットをコンパイル時に列挙しておき、攻撃範囲の計算や反撃判定でヒープ確保をしない
+///----------------------------------------------------------------------------
+
+#include <cstdint>
+
+// ユニットの武器タイプ
+enum class WeaponType {
+	Sword,      // 剣(近接)
+	Bow,        // 弓(遠距離)
+	Lance,      // 槍(近接～間接)
+	Longbow,    // 長弓(遠距離)
+	Count
+};
+
+constexpr int MAX_WEAPON_RANGE = 3; // 武器の最大射程の上限
+
+// 武器の射程(マンハッタン距離)
+struct WeaponSpec {
+	int min_range;
+	int max_range;
+};
+
+// 武器ごとの射程表(WeaponTypeの順)
+constexpr WeaponSpec kWeaponSpecs[(int)WeaponType::Count] = {
+	{ 1, 1 }, // Sword
+	{ 2, 2 }, // Bow
+	{ 1, 2 }, // Lance
+	{ 2, 3 }, // Longbow
+};
+
+inline constexpr const WeaponSpec& get_weapon_spec(WeaponType weapon) {
+	return kWeaponSpecs[(int)weapon];
+}
+
+// 攻撃範囲のステンシル(攻撃者から見た射程内マスのオフセット一覧)
+struct AttackStencil {
+	static constexpr int kMaxOffsets = 2 * MAX_WEAPON_RANGE * (MAX_WEAPON_RANGE + 1); // ひし形の外周の合計
+
+	int8_t dx[kMaxOffsets] = {};
+	int8_t dy[kMaxOffsets] = {};
+	int count = 0;
+};
+
+// 射程からステンシルを作る関数(コンパイル時に評価する)
+constexpr AttackStencil make_attack_stencil(int min_range, int max_range) {
+	AttackStencil stencil;
+	for (int dy = -max_range; dy <= max_range; ++dy) {
+		for (int dx = -max_range; dx <= max_range; ++dx) {
+			int dist = (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+			if (dist >= min_range && dist <= max_range) {
+				stencil.dx[stencil.count] = (int8_t)dx;
+				stencil.dy[stencil.count] = (int8_t)dy;
+				++stencil.count;
+			}
+		}
+	}
+	return stencil;
+}
+
+// 武器ごとのステンシル(WeaponTypeの順)
+constexpr AttackStencil kAttackStencils[(int)WeaponType::Count] = {
+	make_attack_stencil(kWeaponSpecs[0].min_range, kWeaponSpecs[0].max_range),
+	make_attack_stencil(kWeaponSpecs[1].min_range, kWeaponSpecs[1].max_range),
+	make_attack_stencil(kWeaponSpecs[2].min_range, kWeaponSpecs[2].max_range),
+	make_attack_stencil(kWeaponSpecs[3].min_range, kWeaponSpecs[3].max_range),
+};
+static_assert(kAttackStencils[(int)WeaponType::Sword].count == 4);
+static_assert(kAttackStencils[(int)WeaponType::Bow].count == 8);
+
+inline constexpr const AttackStencil& get_attack_stencil(WeaponType weapon) {
+	return kAttackStencils[(int)weapon];
+}
+
+// 武器で(dx, dy)だけ離れたマスを攻撃できるかどうか(O(1))
+inline constexpr bool in_weapon_range(WeaponType weapon, int dx, int dy) {
+	int dist = (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+	const WeaponSpec& spec = get_weapon_spec(weapon);
+	return dist >= spec.min_range && dist <= spec.max_range;
+}
@@ -0,0 +1,89 @@
+#include "srpg/WorkerPool.h"
+
+namespace {
+
+// このスレッドが仕事を処理中のプールとそのワーカー番号(入れ子のparallel_forを見分けるため)
+thread_local const WorkerPool* t_current_pool = nullptr;
+thread_local int t_current_worker = 0;
+
+} // namespace
+
+WorkerPool::WorkerPool(int thread_count) {
+	if (thread_count <= 0) thread_count = (int)std::thread::hardware_concurrency();
+	if (thread_count <= 0) thread_count = 1;
+	for (int i = 1; i < thread_count; ++i) {
+		threads_.emplace_back([this, i] { worker_main(i); });
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	start_cv_.notify_all();
+	for (auto& t : threads_) t.join();
+}
+
+void WorkerPool::parallel_for(int count, const std::function<void(int, int)>& func) {
+	if (count <= 0) return;
+	// 入れ子の呼び出しはcall_mutex_を取ると終わらなくなるので、このスレッドだけで処理する
+	if (t_current_pool == this) {
+		for (int i = 0; i < count; ++i) func(i, t_current_worker);
+		return;
+	}
+	if (threads_.empty() || count == 1) {
+		for (int i = 0; i < count; ++i) func(i, 0);
+		return;
+	}
+
+	std::lock_guard<std::mutex> call_lock(call_mutex_);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job_ = &func;
+		count_ = count;
+		next_.store(0);
+		active_ = (int)threads_.size();
+		++generation_;
+	}
+	start_cv_.notify_all();
+
+	run(0);
+
+	// すべてのワーカースレッドが仕事を終えるまで待つ(終えるまで次の仕事は投入されない)
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_cv_.wait(lock, [this] { return active_ == 0; });
+	job_ = nullptr;
+}
+
+void WorkerPool::worker_main(int worker) {
+	uint64_t seen = 0;
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;) {
+		start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+		if (stop_) return;
+		seen = generation_;
+
+		lock.unlock();
+		run(worker);
+		lock.lock();
+		if (--active_ == 0) done_cv_.notify_one();
+	}
+}
+
+void WorkerPool::run(int worker) {
+	const std::function<void(int, int)>& func = *job_;
+	// 別のプールの仕事の中から呼ばれることもあるので、前の値に戻す
+	const WorkerPool* outer_pool = t_current_pool;
+	const int outer_worker = t_current_worker;
+	t_current_pool = this;
+	t_current_worker = worker;
+	for (int i = next_.fetch_add(1); i < count_; i = next_.fetch_add(1)) func(i, worker);
+	t_current_pool = outer_pool;
+	t_current_worker = outer_worker;
+}
+
+WorkerPool& default_worker_pool() {
+	static WorkerPool pool;
+	return pool;
+}
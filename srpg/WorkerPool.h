@@ -0,0 +1,52 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 計算用のワーカースレッドのプール
+/// 呼び出し元のスレッドも1人のワーカーとして働き、すべての要素が終わるまで戻らない
+///----------------------------------------------------------------------------
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+	// thread_countは呼び出し元を含むワーカー数(0ならハードウェアのスレッド数)
+	explicit WorkerPool(int thread_count = 0);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// 呼び出し元を含むワーカー数(ワーカーごとの作業領域の数)
+	int size() const { return (int)threads_.size() + 1; }
+
+	// [0, count)の各要素についてfunc(index, worker)を並列に呼ぶ(workerは0～size()-1)
+	// 要素の処理順はスレッドの都合で変わるので、結果は要素ごとの領域に書き込むこと
+	// funcの中から同じプールのparallel_forを呼ぶと(入れ子)、ワーカーは全員使用中なので呼んだスレッドだけで順に処理する
+	// このときのworkerは呼んだスレッドのworkerと同じ値なので、外側のfuncが使っているワーカーごとの領域を内側で共有しないこと
+	void parallel_for(int count, const std::function<void(int, int)>& func);
+
+private:
+	void worker_main(int worker);
+	void run(int worker);
+
+	std::vector<std::thread> threads_;
+	std::mutex call_mutex_; // parallel_forを同時に呼ばれたときは順番に処理する
+	std::mutex mutex_;
+	std::condition_variable start_cv_;
+	std::condition_variable done_cv_;
+	const std::function<void(int, int)>* job_ = nullptr;
+	int count_ = 0;
+	std::atomic<int> next_{ 0 };
+	int active_ = 0;          // 現在の仕事を終えていないワーカースレッドの数
+	uint64_t generation_ = 0; // 仕事を投入するたびに増える番号
+	bool stop_ = false;
+};
+
+// 共有のワーカープール(初回の呼び出しで作る)
+WorkerPool& default_worker_pool();
@@ -0,0 +1,165 @@
+// 戦闘の記録: 記録した戦闘を再生して、フェーズの境目ごとの盤面が記録時と一致するかを確かめる
+
+#include "tests/Test.h"
+
+#include <map>
+#include <sstream>
+#include <utility>
+
+#include "srpg/WorkerPool.h"
+
+namespace {
+
+bool same_state(const BattleState& a, const BattleState& b) {
+	if (a.turn != b.turn || a.current_phase != b.current_phase) return false;
+	if (a.rng.key != b.rng.key || a.rng.counter != b.rng.counter) return false;
+	if (a.units.size() != b.units.size() || a.occupancy != b.occupancy) return false;
+	for (int i = 0; i < a.units.size(); ++i) {
+		const Unit u = a.units.get(i);
+		const Unit v = b.units.get(i);
+		if (u.name != v.name || u.x != v.x || u.y != v.y || u.hp != v.hp || u.is_enemy != v.is_enemy) return false;
+		if (u.has_moved != v.has_moved || u.has_attacked != v.has_attacked) return false;
+		if (u.atk != v.atk || u.def != v.def || u.hit != v.hit || u.crit != v.crit || u.weapon != v.weapon) return false;
+	}
+	for (int y = 0; y < a.map.height(); ++y) {
+		for (int x = 0; x < a.map.width(); ++x) {
+			if (a.map.at(x, y) != b.map.at(x, y)) return false;
+		}
+	}
+	return true;
+}
+
+// AI同士の戦闘を記録し、フェーズの境目ごとの盤面を(ターン, フェーズ)で返す
+// プレイヤーの手動の移動(step)、地形の変更、ユニットの追加も途中に混ぜる
+std::map<std::pair<int, int>, BattleState> record_battle(std::mt19937& rng, BattleState& state, BattleEventWriter& writer, WorkerPool& pool) {
+	auto uniform = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+	std::map<std::pair<int, int>, BattleState> boundaries;
+	state.events.writer = &writer;
+	writer.begin(state);
+	boundaries[{ state.turn, state.current_phase }] = state;
+
+	for (int t = 0; t < 12 && get_battle_result(state) == BattleResult::Ongoing; ++t) {
+		if (t % 3 == 0) {
+			// プレイヤーユニット1体を手で動かす
+			for (int i : state.factions.live(false)) {
+				const std::vector<int> range = get_cached_move_range(state, i);
+				const TileGrid& grid = state.map.grid();
+				for (int tile : range) {
+					if (step(state, { ActionType::Move, i, grid.x_of(tile), grid.y_of(tile) })) break;
+				}
+				break;
+			}
+		}
+		if (t == 4) {
+			int x = uniform(0, state.map.width() - 1);
+			int y = uniform(0, state.map.height() - 1);
+			if (!is_occupied(state, x, y)) {
+				set_tile(state, x, y, PLAIN);
+				Unit u;
+				u.name = "reinforcement";
+				u.x = x;
+				u.y = y;
+				u.is_enemy = uniform(0, 1) != 0;
+				u.hp = 15;
+				u.move = 3;
+				u.atk = 6;
+				u.hit = 80;
+				add_unit(state, u);
+			}
+		}
+		player_ai_turn(state, pool);
+		boundaries[{ state.turn, state.current_phase }] = state;
+		if (get_battle_result(state) != BattleResult::Ongoing) break;
+		enemy_turn_logic(state, pool);
+		boundaries[{ state.turn, state.current_phase }] = state;
+	}
+	return boundaries;
+}
+
+RandomBattleOptions replay_battle() {
+	RandomBattleOptions options;
+	options.min_size = 12;
+	options.max_size = 28;
+	options.min_units = 10;
+	options.max_units = 30;
+	options.rolls = true;
+	return options;
+}
+
+} // namespace
+
+SRPG_TEST(replay_reproduces_every_phase) {
+	std::mt19937 rng(31);
+	WorkerPool pool(1);
+	for (int round = 0; round < 20; ++round) {
+		BattleState state = make_random_battle(rng, replay_battle());
+		BattleEventWriter writer(1 + round % 4);
+		const auto boundaries = record_battle(rng, state, writer, pool);
+
+		// ファイルに書いて読み直す
+		std::stringstream file;
+		CHECK(writer.save(file));
+		BattleReplay replay;
+		std::string error;
+		CHECK(replay.load(file, error));
+		CHECK(replay.first_turn() == boundaries.begin()->first.first);
+		CHECK(replay.last_turn() == state.turn);
+
+		for (const auto& [key, expected] : boundaries) {
+			BattleState replayed;
+			CHECK(replay.seek(key.first, (Phase)key.second, replayed));
+			CHECK(same_state(replayed, expected));
+
+			// 再生した盤面からAIを動かすと、記録した盤面から動かした場合と同じ行動になる
+			if (expected.current_phase == EnemyTurn && get_battle_result(expected) == BattleResult::Ongoing) {
+				BattleState a = expected;
+				BattleState b = replayed;
+				enemy_turn_logic(a, pool);
+				enemy_turn_logic(b, pool);
+				CHECK(same_state(a, b));
+			}
+		}
+		BattleState end;
+		CHECK(replay.seek_end(end));
+		CHECK(same_state(end, state));
+
+		BattleState missing;
+		CHECK(!replay.seek(state.turn + 5, PlayerTurn, missing));
+	}
+}
+
+SRPG_TEST(replay_rejects_broken_streams) {
+	std::mt19937 rng(37);
+	WorkerPool pool(1);
+	BattleState state = make_random_battle(rng, replay_battle());
+	BattleEventWriter writer(2);
+	record_battle(rng, state, writer, pool);
+	const std::vector<uint8_t>& bytes = writer.bytes();
+
+	BattleReplay replay;
+	std::string error;
+	CHECK(!replay.load(std::vector<uint8_t>(bytes.begin(), bytes.begin() + 4), error)); // 先頭の識別子が足りない
+	std::vector<uint8_t> wrong_magic = bytes;
+	wrong_magic[0] = 'X';
+	CHECK(!replay.load(wrong_magic, error));
+	std::vector<uint8_t> truncated(bytes.begin(), bytes.end() - 1); // 最後の件が途中で切れている
+	CHECK(!replay.load(truncated, error));
+	CHECK(replay.load(bytes, error));
+
+	// 壊れたバイト列でも読み込みと再生が範囲外を読まずに終わる
+	for (int k = 0; k < 300; ++k) {
+		std::vector<uint8_t> broken = bytes;
+		if (k % 2 == 0) {
+			broken.resize(8 + rng() % (broken.size() - 8));
+		}
+		else {
+			for (int n = 0; n < 4; ++n) broken[8 + rng() % (broken.size() - 8)] = (uint8_t)rng();
+		}
+		BattleReplay r;
+		if (r.load(broken, error)) {
+			BattleState out;
+			r.seek_end(out);
+			r.seek(r.first_turn() + 1, EnemyTurn, out);
+		}
+	}
+}
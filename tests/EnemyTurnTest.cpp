@@ -0,0 +1,56 @@
+// ワーカープールで並列に計画を立てるエネミーターンを、1体ずつ順に計画する場合(1スレッド)と比べる
+
+#include "tests/Test.h"
+
+#include "srpg/WorkerPool.h"
+
+namespace {
+
+bool same_units(const BattleState& a, const BattleState& b) {
+	const UnitTable& u = a.units;
+	const UnitTable& v = b.units;
+	return u.x == v.x && u.y == v.y && u.hp == v.hp && u.has_moved == v.has_moved && u.has_attacked == v.has_attacked;
+}
+
+bool same_plan(const EnemyPlan& a, const EnemyPlan& b) {
+	return a.unit == b.unit && a.target == b.target && a.moves == b.moves && a.move_x == b.move_x && a.move_y == b.move_y &&
+		a.attack_target == b.attack_target;
+}
+
+} // namespace
+
+SRPG_TEST(parallel_enemy_turn_matches_serial) {
+	std::mt19937 rng(13);
+	RandomBattleOptions options;
+	options.min_size = 24;
+	options.max_size = 32;
+	options.min_units = 90; // 並列に計画を立てる敵の数の下限を超えるようにする
+	options.max_units = 140;
+	options.rolls = true;
+	WorkerPool serial(1);
+	WorkerPool parallel(4);
+	for (int round = 0; round < 12; ++round) {
+		BattleState a = make_random_battle(rng, options);
+		BattleState b = a;
+		for (int turn = 0; turn < 4 && get_battle_result(a) == BattleResult::Ongoing; ++turn) {
+			player_ai_turn(a, serial);
+			player_ai_turn(b, parallel);
+			CHECK(same_units(a, b));
+
+			const BattleState start = a;
+			std::vector<EnemyPlan> plans_a, plans_b;
+			enemy_turn_logic(a, serial, nullptr, &plans_a);
+			enemy_turn_logic(b, parallel, nullptr, &plans_b);
+			CHECK(same_units(a, b));
+			CHECK(a.rng.counter == b.rng.counter);
+			CHECK(plans_a.size() == plans_b.size());
+			for (size_t k = 0; k < plans_a.size() && k < plans_b.size(); ++k) CHECK(same_plan(plans_a[k], plans_b[k]));
+
+			// 記録した計画をターン開始時の状態に順に適用すれば同じ結果になる
+			BattleState replayed = start;
+			for (const EnemyPlan& plan : plans_b) apply_enemy_plan(replayed, plan);
+			end_enemy_turn(replayed);
+			CHECK(same_units(replayed, b));
+		}
+	}
+}
@@ -0,0 +1,76 @@
+// 陣営への距離場を、ユニットごとに相手の陣営まで最短経路を探す素朴な実装と比べる
+
+#include "tests/Test.h"
+
+#include <functional>
+#include <queue>
+#include <tuple>
+
+namespace {
+
+// 素朴な実装: (sx, sy)から相手の陣営のいずれかのユニットのマスまでの最小移動コスト
+// ユニットによる通行止めは無視し、ユニットのいるマスへは地形によらずコスト1で入れる
+int reference_distance(const BattleState& state, bool to_enemy, MoveClass move_class, int sx, int sy) {
+	const TileGrid& grid = state.map.grid();
+	auto is_goal = [&](int x, int y) {
+		int occupant = unit_at(state, x, y);
+		return occupant != NO_UNIT && (state.units.is_enemy[occupant] != 0) == to_enemy;
+	};
+	if (is_goal(sx, sy)) return 0;
+	if (state.move_costs.at(move_class, state.map.at(sx, sy)) == IMPASSABLE) return kFlowUnreachable;
+
+	std::vector<int> best(grid.tile_count(), kFlowUnreachable);
+	using Item = std::tuple<int, int, int>; // コスト, x, y
+	std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+	best[grid.index(sx, sy)] = 0;
+	open.push({ 0, sx, sy });
+	while (!open.empty()) {
+		auto [d, x, y] = open.top();
+		open.pop();
+		if (best[grid.index(x, y)] != d) continue;
+		if (is_goal(x, y)) return d;
+		const int dirs[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
+		for (auto& dir : dirs) {
+			int nx = x + dir[0];
+			int ny = y + dir[1];
+			if (!grid.contains(nx, ny)) continue;
+			int cost = is_goal(nx, ny) ? 1 : state.move_costs.at(move_class, state.map.at(nx, ny));
+			if (cost == IMPASSABLE) continue;
+			int nd = d + cost;
+			if (nd >= best[grid.index(nx, ny)]) continue;
+			best[grid.index(nx, ny)] = nd;
+			open.push({ nd, nx, ny });
+		}
+	}
+	return kFlowUnreachable;
+}
+
+} // namespace
+
+SRPG_TEST(flow_field_matches_per_unit_search) {
+	std::mt19937 rng(29);
+	auto uniform = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+	for (int round = 0; round < 60; ++round) {
+		BattleState state = make_random_battle(rng);
+		for (bool for_enemy : { false, true }) {
+			FlowFieldSet flow;
+			compute_flow_fields(state, for_enemy, flow);
+			for (int c = 0; c < (int)MoveClass::Count; ++c) {
+				const FlowField* field = flow.get((MoveClass)c);
+				if (!field) continue;
+				// 陣営のユニットの位置と、ランダムなマス
+				for (int u : state.factions.live(for_enemy)) {
+					if (state.units.move_class[u] != (MoveClass)c) continue;
+					int x = state.units.x[u];
+					int y = state.units.y[u];
+					CHECK(field->distance_at(x, y) == reference_distance(state, !for_enemy, (MoveClass)c, x, y));
+				}
+				for (int k = 0; k < 20; ++k) {
+					int x = uniform(0, state.map.width() - 1);
+					int y = uniform(0, state.map.height() - 1);
+					CHECK(field->distance_at(x, y) == reference_distance(state, !for_enemy, (MoveClass)c, x, y));
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,66 @@
+// ユニットの移動・撃破・追加や地形の変更で差分だけ更新した影響マップを、作り直した結果と比べる
+
+#include "tests/Test.h"
+
+namespace {
+
+bool same_influence(const BattleState& state) {
+	BattleState rebuilt = state;
+	rebuild_influence(rebuilt);
+	for (int layer = 0; layer < InfluenceMap::LayerCount; ++layer) {
+		for (int y = 0; y < state.map.height(); ++y) {
+			for (int x = 0; x < state.map.width(); ++x) {
+				const auto l = (InfluenceMap::Layer)layer;
+				if (state.influence.at(l, x, y) != rebuilt.influence.at(l, x, y)) return false;
+				if (state.influence.source_at(l, x, y) != rebuilt.influence.source_at(l, x, y)) return false;
+			}
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+SRPG_TEST(incremental_influence_matches_rebuild) {
+	std::mt19937 rng(23);
+	auto uniform = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+	for (int round = 0; round < 60; ++round) {
+		BattleState state = make_random_battle(rng);
+		if (state.units.empty()) continue;
+		const int w = state.map.width();
+		const int h = state.map.height();
+		for (int step = 0; step < 80; ++step) {
+			int x = uniform(0, w - 1);
+			int y = uniform(0, h - 1);
+			int unit = uniform(0, state.units.size() - 1);
+			switch (uniform(0, 3)) {
+			case 0: // 移動
+				if (state.units.hp[unit] > 0 && !is_occupied(state, x, y)) move_unit(state, unit, x, y);
+				break;
+			case 1: { // 攻撃(倒れることもある)
+				int target = uniform(0, state.units.size() - 1);
+				if (state.units.hp[unit] > 0 && state.units.hp[target] > 0 && state.units.is_enemy[unit] != state.units.is_enemy[target]) {
+					attack(state, unit, target);
+				}
+				break;
+			}
+			case 2: // 地形の変更
+				set_tile(state, x, y, (TileType)uniform(0, TILE_TYPE_COUNT - 1));
+				break;
+			case 3: { // ユニットの追加
+				if (is_occupied(state, x, y)) break;
+				Unit u;
+				u.name = "spawn";
+				u.x = x;
+				u.y = y;
+				u.is_enemy = uniform(0, 1) != 0;
+				u.hp = 10;
+				u.atk = uniform(1, 10);
+				add_unit(state, u);
+				break;
+			}
+			}
+			CHECK(same_influence(state));
+		}
+	}
+}
@@ -0,0 +1,85 @@
+// 移動範囲(TileSetとバケットキュー)を、std::setに集める素朴な最短経路探索と比べる
+
+#include "tests/Test.h"
+
+#include <functional>
+#include <map>
+#include <queue>
+#include <set>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+// 素朴な実装: 優先度付きキューで最短コストを求め、到達したマスと移動コストをstd::mapに集める
+std::map<std::pair<int, int>, int> reference_move_range(const BattleState& state, int unit_index) {
+	const UnitTable& u = state.units;
+	std::map<std::pair<int, int>, int> best;
+	using Item = std::tuple<int, int, int>; // コスト, x, y
+	std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+	open.push({ 0, u.x[unit_index], u.y[unit_index] });
+	best[{ u.x[unit_index], u.y[unit_index] }] = 0;
+	while (!open.empty()) {
+		auto [d, x, y] = open.top();
+		open.pop();
+		if (best[{ x, y }] != d) continue;
+		const int dirs[4][2] = { {1,0}, {-1,0}, {0,1}, {0,-1} };
+		for (auto& dir : dirs) {
+			int nx = x + dir[0];
+			int ny = y + dir[1];
+			if (!is_within_bounds(state, nx, ny) || !is_tile_passable(state, unit_index, nx, ny)) continue;
+			int occupant = unit_at(state, nx, ny);
+			if (occupant != NO_UNIT && u.is_enemy[occupant] != u.is_enemy[unit_index]) continue;
+			int nd = d + get_move_cost(state, unit_index, nx, ny);
+			if (nd > u.move[unit_index]) continue;
+			auto it = best.find({ nx, ny });
+			if (it != best.end() && it->second <= nd) continue;
+			best[{ nx, ny }] = nd;
+			open.push({ nd, nx, ny });
+		}
+	}
+	return best;
+}
+
+// 1体分の移動範囲を比べる
+void check_move_range(const BattleState& state, int unit_index, MoveScratch& scratch) {
+	const auto expected = reference_move_range(state, unit_index);
+	TileSet range;
+	get_move_range(state, unit_index, range, scratch);
+
+	std::set<std::pair<int, int>> tiles;
+	for (int y = 0; y < state.map.height(); ++y) {
+		for (int x = 0; x < state.map.width(); ++x) {
+			if (range.contains(x, y)) tiles.insert({ x, y });
+		}
+	}
+	CHECK(tiles.size() == expected.size());
+	for (const auto& [tile, cost] : expected) {
+		CHECK(tiles.count(tile) == 1);
+		CHECK(scratch.distance_at(tile.first, tile.second) == cost);
+	}
+}
+
+} // namespace
+
+SRPG_TEST(move_range_matches_reference_on_plain_maps) {
+	std::mt19937 rng(3);
+	RandomBattleOptions options;
+	options.weighted = false;
+	options.move_classes = false;
+	MoveScratch scratch;
+	for (int round = 0; round < 200; ++round) {
+		BattleState state = make_random_battle(rng, options);
+		for (int i = 0; i < state.units.size(); ++i) check_move_range(state, i, scratch);
+	}
+}
+
+SRPG_TEST(move_range_matches_reference_with_terrain_costs) {
+	std::mt19937 rng(5);
+	MoveScratch scratch;
+	for (int round = 0; round < 300; ++round) {
+		BattleState state = make_random_battle(rng);
+		CHECK(state.move_costs.valid());
+		for (int i = 0; i < state.units.size(); ++i) check_move_range(state, i, scratch);
+	}
+}
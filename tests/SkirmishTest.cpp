@@ -0,0 +1,135 @@
+// 終盤のアルファベータ探索: 盤面のハッシュと、探索が返す行動・実行後の盤面の整合性を確かめる
+// (置換表は反復深化の深い結果も使うので、値そのものは素朴なミニマックスと一致するとは限らない)
+
+#include "tests/Test.h"
+
+#include <algorithm>
+
+#include "srpg/Skirmish.h"
+
+namespace {
+
+// 占有グリッドが生存ユニットの位置と一致し、同じマスに2体いないか
+bool occupancy_consistent(const BattleState& state) {
+	BattleState rebuilt = state;
+	rebuild_occupancy(rebuilt);
+	int alive = 0;
+	for (int i = 0; i < state.units.size(); ++i) alive += state.units.hp[i] > 0 ? 1 : 0;
+	int occupied = 0;
+	for (int v : state.occupancy) occupied += v != 0 ? 1 : 0;
+	return rebuilt.occupancy == state.occupancy && occupied == alive;
+}
+
+RandomBattleOptions small_battle() {
+	RandomBattleOptions options;
+	options.max_size = 12;
+	options.min_units = 2;
+	options.max_units = 6;
+	options.rolls = true;
+	return options;
+}
+
+} // namespace
+
+SRPG_TEST(skirmish_hash_identifies_transpositions) {
+	std::mt19937 rng(17);
+	SkirmishSearch search;
+	for (int round = 0; round < 200; ++round) {
+		BattleState state = make_random_battle(rng, small_battle());
+		if (state.units.empty()) continue;
+		const uint64_t key = search.hash(state);
+
+		// 同じ盤面は同じハッシュ
+		BattleState copy = state;
+		CHECK(search.hash(copy) == key);
+
+		// ユニット2体を別々の順番で動かしても、同じ盤面になれば同じハッシュ
+		if (state.units.size() >= 2) {
+			const std::vector<int> tiles0 = get_cached_move_range(state, 0);
+			const std::vector<int> tiles1 = get_cached_move_range(state, 1);
+			const TileGrid& grid = state.map.grid();
+			auto is_free = [&](int i) { return !is_occupied(state, grid.x_of(i), grid.y_of(i)); };
+			auto a = std::find_if(tiles0.begin(), tiles0.end(), is_free);
+			auto b = std::find_if(tiles1.begin(), tiles1.end(), [&](int i) { return is_free(i) && (a == tiles0.end() || i != *a); });
+			if (a != tiles0.end() && b != tiles1.end()) {
+				BattleState ab = state;
+				move_unit(ab, 0, grid.x_of(*a), grid.y_of(*a));
+				move_unit(ab, 1, grid.x_of(*b), grid.y_of(*b));
+				BattleState ba = state;
+				move_unit(ba, 1, grid.x_of(*b), grid.y_of(*b));
+				move_unit(ba, 0, grid.x_of(*a), grid.y_of(*a));
+				CHECK(search.hash(ab) == search.hash(ba));
+				CHECK(search.hash(ab) != key);
+			}
+		}
+
+		// hp・行動済み・手番が変われば別のハッシュ
+		BattleState hurt = state;
+		hurt.units.hp[0] -= 1;
+		CHECK(search.hash(hurt) != key);
+		BattleState acted = state;
+		acted.units.has_moved[0] = 1;
+		CHECK(search.hash(acted) != key);
+		BattleState phase = state;
+		phase.current_phase = phase.current_phase == PlayerTurn ? EnemyTurn : PlayerTurn;
+		CHECK(search.hash(phase) != key);
+
+		// 判定が要るユニットがいれば、乱数の続きが違う盤面も別のハッシュ
+		BattleState rolled = state;
+		rolled.units.hit[0] = 90;
+		BattleState advanced = rolled;
+		advanced.rng.counter += 1;
+		CHECK(search.hash(advanced) != search.hash(rolled));
+	}
+}
+
+SRPG_TEST(skirmish_search_returns_valid_actions) {
+	std::mt19937 rng(19);
+	SkirmishConfig config;
+	config.time_budget_ms = 0.0;
+	config.max_depth = 4;
+	MoveScratch scratch;
+	for (int round = 0; round < 150; ++round) {
+		BattleState state = make_random_battle(rng, small_battle());
+		state.current_phase = EnemyTurn;
+		if (state.factions.live(true).empty() || state.factions.live(false).empty()) continue;
+
+		SkirmishSearch search(config);
+		SkirmishResult result = search.search(state);
+		CHECK(result.depth >= 1);
+		CHECK(result.action.unit >= 0 && state.units.is_enemy[result.action.unit]);
+		CHECK(is_enemy_plan_valid(state, result.action, scratch));
+
+		// 探索で敵のターンを実行しても、盤面は壊れない
+		skirmish_enemy_turn(state, config);
+		CHECK(occupancy_consistent(state));
+		CHECK(state.current_phase == PlayerTurn);
+	}
+}
+
+SRPG_TEST(skirmish_table_ignores_other_rng_states) {
+	// 同じ盤面でも乱数が違えば読みの結果は変わるので、前の探索の置換表を引き継いでも空の置換表と同じ結果になる
+	std::mt19937 rng(29);
+	SkirmishConfig config;
+	config.time_budget_ms = 0.0;
+	config.max_depth = 4;
+	config.table_bits = 16;
+	SkirmishSearch warm(config);
+	for (int round = 0; round < 150; ++round) {
+		BattleState state = make_random_battle(rng, small_battle());
+		state.current_phase = EnemyTurn;
+		if (state.factions.live(true).empty() || state.factions.live(false).empty()) continue;
+
+		BattleState other = state;
+		other.rng = CombatRng(rng());
+		warm.search(state);
+		const SkirmishResult reused = warm.search(other);
+		SkirmishSearch cleared(config);
+		const SkirmishResult fresh = cleared.search(other);
+		CHECK(reused.value == fresh.value);
+		CHECK(reused.depth == fresh.depth);
+		CHECK(reused.nodes == fresh.nodes);
+		CHECK(reused.action.unit == fresh.action.unit && reused.action.move_x == fresh.action.move_x &&
+			reused.action.move_y == fresh.action.move_y && reused.action.attack_target == fresh.action.attack_target);
+	}
+}
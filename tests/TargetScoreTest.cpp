@@ -0,0 +1,30 @@
+// 候補マスと攻撃対象の評価カーネル(SSE2/AVX2)を、スカラー版と比べる
+
+#include "tests/Test.h"
+
+#include "srpg/TargetScore.h"
+
+SRPG_TEST(target_score_kernels_match_scalar) {
+	std::mt19937 rng(11);
+	auto uniform = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+	const ScoreKernel kernels[] = { ScoreKernel::SSE2, ScoreKernel::AVX2 };
+	for (int round = 0; round < 2000; ++round) {
+		// 候補マスの数はベクトル幅の倍数にならないものも混ぜる
+		TargetScoreBatch batch;
+		const int tiles = uniform(0, 70);
+		const int targets = uniform(0, 12);
+		for (int i = 0; i < tiles; ++i) batch.add_tile(uniform(0, 40), uniform(0, 40));
+		for (int t = 0; t < targets; ++t) batch.add_target(uniform(0, 40), uniform(0, 40), uniform(0, 6), t);
+		const int min_range = uniform(0, 3);
+		const int max_range = min_range + uniform(0, 4);
+
+		TargetScoreBatch expected = batch;
+		score_targets(expected, min_range, max_range, ScoreKernel::Scalar);
+		for (ScoreKernel kernel : kernels) {
+			TargetScoreBatch actual = batch;
+			score_targets(actual, min_range, max_range, kernel);
+			CHECK(actual.best_damage == expected.best_damage);
+			CHECK(actual.best_target == expected.best_target);
+		}
+	}
+}
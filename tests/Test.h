@@ -0,0 +1,44 @@
+#pragma once
+
+///----------------------------------------------------------------------------
+/// 最適化した処理と素朴な実装の結果を比べるテストの仕組み
+/// SRPG_TESTで登録した関数をsrpg_testsがすべて(引数があれば名前が一致するものだけ)実行する
+/// CHECKが失敗してもそのテストは最後まで続け、失敗した数を終了コードで返す
+///----------------------------------------------------------------------------
+
+#include <cstdint>
+#include <random>
+
+#include "srpg/Battle.h"
+
+// テストの登録
+struct TestRegistrar {
+	TestRegistrar(const char* name, void (*function)());
+};
+
+#define SRPG_TEST(name) \
+	static void name(); \
+	static TestRegistrar name##_registrar(#name, name); \
+	static void name()
+
+// 失敗を記録する(CHECKから呼ぶ)
+void test_fail(const char* file, int line, const char* expression);
+
+#define CHECK(expression) \
+	do { \
+		if (!(expression)) test_fail(__FILE__, __LINE__, #expression); \
+	} while (0)
+
+// ランダムな盤面の設定
+struct RandomBattleOptions {
+	int min_size = 8;         // マップの一辺の範囲
+	int max_size = 24;
+	int min_units = 4;        // ユニット数の範囲(置けるマスが足りなければ少なくなる)
+	int max_units = 16;
+	bool rolls = false;       // 命中率・会心率を100%/0%以外にするか
+	bool weighted = true;     // 丘など移動コストが1でない地形を置くか
+	bool move_classes = true; // 騎兵・飛行のユニットを混ぜるか
+};
+
+// ランダムな地形(レイアウトもランダム)とユニットで盤面を作る(ユニットは平地か丘の別々のマスに置く)
+BattleState make_random_battle(std::mt19937& rng, const RandomBattleOptions& options = RandomBattleOptions());
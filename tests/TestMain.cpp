@@ -0,0 +1,86 @@
+#include "tests/Test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct TestCase {
+	const char* name;
+	void (*function)();
+};
+
+std::vector<TestCase>& registry() {
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+int failures = 0;
+
+} // namespace
+
+TestRegistrar::TestRegistrar(const char* name, void (*function)()) {
+	registry().push_back({ name, function });
+}
+
+void test_fail(const char* file, int line, const char* expression) {
+	std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+	++failures;
+}
+
+BattleState make_random_battle(std::mt19937& rng, const RandomBattleOptions& options) {
+	auto uniform = [&](int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+	const int width = uniform(options.min_size, options.max_size);
+	const int height = uniform(options.min_size, options.max_size);
+	TileMap map(width, height, uniform(0, 1) ? TileLayout::Blocked : TileLayout::RowMajor);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int r = uniform(0, 9);
+			TileType tile = r < 6 ? PLAIN : r < 7 ? FOREST : r < 8 ? WATER : (options.weighted ? HILL : PLAIN);
+			map.set(x, y, (uint8_t)tile);
+		}
+	}
+
+	std::vector<Unit> units;
+	std::vector<uint8_t> taken(map.grid().tile_count(), 0);
+	const int count = uniform(options.min_units, options.max_units);
+	for (int k = 0; k < count; ++k) {
+		Unit u;
+		u.x = uniform(0, width - 1);
+		u.y = uniform(0, height - 1);
+		uint8_t& tile = taken[map.index(u.x, u.y)];
+		if (tile || map.at(u.x, u.y) == FOREST || map.at(u.x, u.y) == WATER) continue; // 歩兵が入れないマスには置かない
+		tile = 1;
+		u.name = std::to_string(k);
+		u.is_enemy = uniform(0, 1) != 0;
+		u.hp = uniform(5, 25);
+		u.move = uniform(1, 6);
+		u.atk = uniform(3, 10);
+		u.def = uniform(0, 4);
+		u.weapon = (WeaponType)uniform(0, (int)WeaponType::Count - 1);
+		if (options.move_classes) u.move_class = (MoveClass)uniform(0, (int)MoveClass::Count - 1);
+		if (options.rolls) {
+			u.hit = uniform(50, 100);
+			u.crit = uniform(0, 30);
+		}
+		units.push_back(u);
+	}
+	BattleState state = make_battle(std::move(map), std::move(units));
+	state.rng = CombatRng(rng());
+	return state;
+}
+
+int main(int argc, char** argv) {
+	int run = 0;
+	for (const TestCase& test : registry()) {
+		if (argc > 1 && std::strcmp(argv[1], test.name) != 0) continue;
+		const int before = failures;
+		test.function();
+		std::printf("%s %s\n", failures == before ? "ok  " : "FAIL", test.name);
+		++run;
+	}
+	std::printf("%d tests, %d failed checks\n", run, failures);
+	return failures == 0 && run > 0 ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+// 脅威マップの最大ダメージを、相手の陣営の全ユニットの移動先から攻撃を1つずつ試す素朴な実装と比べる
+
+#include "tests/Test.h"
+
+#include <algorithm>
+
+#include "srpg/ThreatMap.h"
+
+namespace {
+
+// 素朴な実装: 防御力defのユニットが(x, y)で受けうる1回の最大ダメージ(攻撃されなければ-1)
+int reference_max_damage(const BattleState& state, bool from_enemy, int x, int y, int def) {
+	const UnitTable& u = state.units;
+	int worst = -1;
+	for (int i = 0; i < u.size(); ++i) {
+		if (u.hp[i] <= 0 || (u.is_enemy[i] != 0) != from_enemy) continue;
+		for (int tile : get_cached_move_range(state, i)) {
+			int occupant = state.occupancy[tile] - 1;
+			if (occupant != NO_UNIT && occupant != i) continue;
+			const TileGrid& grid = state.map.grid();
+			if (!can_attack_from(state, i, grid.x_of(tile), grid.y_of(tile), x, y)) continue;
+			worst = std::max(worst, strike_damage(u.atk[i], def, u.crit[i] > 0));
+		}
+	}
+	return worst;
+}
+
+} // namespace
+
+SRPG_TEST(threat_map_counts_critical_hits) {
+	// 会心の一撃を出しうる敵の隣のマスでは、会心のダメージが最大になる
+	TileMap map(6, 6, TileLayout::RowMajor);
+	Unit ally = { "ally", 1, 1, false, 20, 3, false, false, 5, 2, WeaponType::Sword };
+	Unit enemy = { "enemy", 3, 1, true, 20, 1, false, false, 6, 2, WeaponType::Sword };
+	enemy.crit = 10;
+	BattleState state = make_battle(std::move(map), { ally, enemy });
+
+	ThreatMap threat;
+	compute_threat_map(state, true, threat);
+	const CombatForecast forecast = forecast_attack(state, 1, 0, 2, 1);
+	CHECK(forecast.in_range);
+	CHECK(forecast.crit_damage == (6 - 2) * CRITICAL_MULTIPLIER);
+	CHECK(threat.max_damage_at(1, 1, 2) == forecast.crit_damage);
+
+	// 会心率が0なら会心のダメージは見込まない
+	state.units.crit[1] = 0;
+	compute_threat_map(state, true, threat);
+	CHECK(threat.max_damage_at(1, 1, 2) == 6 - 2);
+}
+
+SRPG_TEST(threat_map_matches_reference) {
+	std::mt19937 rng(23);
+	RandomBattleOptions options;
+	options.max_size = 16;
+	options.rolls = true;
+	ThreatMap threat;
+	for (int round = 0; round < 60; ++round) {
+		const BattleState state = make_random_battle(rng, options);
+		for (bool from_enemy : { true, false }) {
+			compute_threat_map(state, from_enemy, threat);
+			for (int y = 0; y < state.map.height(); ++y) {
+				for (int x = 0; x < state.map.width(); ++x) {
+					for (int def = 0; def <= 6; def += 3) {
+						CHECK(threat.max_damage_at(x, y, def) == reference_max_damage(state, from_enemy, x, y, def));
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,25 @@
+// ワーカープールの入れ子の呼び出し: 同じプールのparallel_forをfuncの中から呼んでも止まらず、全要素を1回ずつ処理する
+
+#include "tests/Test.h"
+
+#include <atomic>
+
+#include "srpg/WorkerPool.h"
+
+SRPG_TEST(worker_pool_runs_nested_calls_inline) {
+	WorkerPool pool(4);
+	for (int round = 0; round < 50; ++round) {
+		constexpr int kOuter = 16;
+		constexpr int kInner = 8;
+		std::vector<std::atomic<int>> visits(kOuter * kInner);
+		std::atomic<int> wrong_worker{ 0 };
+		pool.parallel_for(kOuter, [&](int i, int worker) {
+			pool.parallel_for(kInner, [&](int j, int inner_worker) {
+				if (inner_worker != worker) ++wrong_worker;
+				++visits[i * kInner + j];
+			});
+		});
+		CHECK(wrong_worker == 0);
+		for (const std::atomic<int>& v : visits) CHECK(v == 1);
+	}
+}
@@ -0,0 +1,123 @@
+///----------------------------------------------------------------------------
+/// 戦闘の記録(BattleEventWriterで書いたバイト列)の再生
+/// 指定したターンとフェーズの始まりの盤面を作って表示する
+/// --aiを付けると、その盤面からそのフェーズのAIを動かした後の盤面も表示する(乱数も記録時の状態に戻るので、AIの行動を再現できる)
+///
+/// 使い方:
+///   srpg_replay <file> [--turn T] [--phase player|enemy] [--ai]
+///   --turnを省略すると記録の最後の盤面を表示する
+///----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "srpg/Battle.h"
+#include "srpg/WorkerPool.h"
+
+namespace {
+
+// コマンドラインの設定
+struct ReplayOptions {
+	std::string file;
+	int turn = -1; // -1なら記録の最後
+	Phase phase = PlayerTurn;
+	bool run_ai = false;
+};
+
+void print_usage() {
+	std::cerr <<
+		"usage: srpg_replay <file> [--turn T] [--phase player|enemy] [--ai]\n"
+		"  without --turn, the last state in the file is shown\n";
+}
+
+bool parse_options(int argc, char** argv, ReplayOptions& options) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool ok = true;
+		if (arg == "--turn") {
+			char* end = nullptr;
+			ok = i + 1 < argc;
+			if (ok) {
+				long v = std::strtol(argv[++i], &end, 10);
+				ok = *end == '\0' && v >= 0;
+				options.turn = (int)v;
+			}
+		}
+		else if (arg == "--phase") {
+			ok = i + 1 < argc;
+			if (ok) {
+				std::string s = argv[++i];
+				ok = s == "player" || s == "enemy";
+				options.phase = s == "enemy" ? EnemyTurn : PlayerTurn;
+			}
+		}
+		else if (arg == "--ai") options.run_ai = true;
+		else if (options.file.empty() && arg[0] != '-') options.file = arg;
+		else ok = false;
+
+		if (!ok) {
+			std::cerr << "invalid argument: " << arg << "\n";
+			return false;
+		}
+	}
+	return !options.file.empty();
+}
+
+const char* phase_name(Phase phase) {
+	return phase == PlayerTurn ? "player" : "enemy";
+}
+
+// 盤面を表示する
+void print_state(const BattleState& state) {
+	std::printf("turn %d, %s phase, rng counter %llu\n", state.turn, phase_name(state.current_phase), (unsigned long long)state.rng.counter);
+	std::printf("  %-12s %-5s %7s %4s %3s\n", "name", "side", "pos", "hp", "act");
+	for (int i = 0; i < state.units.size(); ++i) {
+		const Unit u = state.units.get(i);
+		std::printf("  %-12s %-5s (%2d,%2d) %4d %c%c%s\n", u.name.c_str(), u.is_enemy ? "enemy" : "ally", u.x, u.y, u.hp,
+			u.has_moved ? 'M' : '-', u.has_attacked ? 'A' : '-', u.hp > 0 ? "" : "  defeated");
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	ReplayOptions options;
+	if (!parse_options(argc, argv, options)) {
+		print_usage();
+		return 2;
+	}
+
+	std::ifstream file(options.file, std::ios::binary);
+	if (!file) {
+		std::cerr << "cannot open: " << options.file << "\n";
+		return 1;
+	}
+	BattleReplay replay;
+	std::string error;
+	if (!replay.load(file, error)) {
+		std::cerr << options.file << ": " << error << "\n";
+		return 1;
+	}
+	std::printf("turns %d-%d, %d snapshots\n", replay.first_turn(), replay.last_turn(), replay.snapshot_count());
+
+	BattleState state;
+	bool found = options.turn < 0 ? replay.seek_end(state) : replay.seek(options.turn, options.phase, state);
+	if (!found) {
+		std::cerr << "turn " << options.turn << " (" << phase_name(options.phase) << ") is not in the file\n";
+		return 1;
+	}
+	print_state(state);
+
+	if (options.run_ai) {
+		// 計画の結果はスレッドの数によらないので1スレッドで動かす
+		WorkerPool pool(1);
+		if (state.current_phase == PlayerTurn) player_ai_turn(state, pool);
+		else enemy_turn_logic(state, pool);
+		std::printf("\nafter AI:\n");
+		print_state(state);
+	}
+	return 0;
+}
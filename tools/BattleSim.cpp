@@ -0,0 +1,372 @@
+///----------------------------------------------------------------------------
+/// バランス調整用のバッチ対戦シミュレータ
+/// シナリオと能力値の組み合わせ(パラメータグリッド)を受け取り、組み合わせごとにAI同士の対戦を
+/// 全コアで大量に回して、勝率と決着までのターン数をCSVに書き出す
+/// 両陣営ともエネミーターンと同じAI(plan_enemy_action)で行動し、攻撃などのルールはゲームと共通
+///
+/// 使い方:
+///   srpg_sim [--scenario <file>|default] [--param <selector>.<field>=<values>]... [--battles N]
+///            [--jitter R] [--max-turns T] [--seed S] [--threads N] [--out <file.csv>]
+///   selector: ユニット名 / ally / enemy / all
+///   field:    hp / move / atk / def / hit / crit / weapon / move_class
+///   values:   5,7,9 のような列挙か、5:9 / 5:9:2 のような範囲(weaponとmove_classは名前の列挙)
+///----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "srpg/Battle.h"
+#include "srpg/Scenario.h"
+#include "srpg/WorkerPool.h"
+
+namespace {
+
+// 変える能力値1つ分(--param 1つ分)
+struct ParamAxis {
+	std::string name;                // CSVの列名(selector.field)
+	std::string selector;            // ユニット名 / ally / enemy / all
+	std::string field;               // 能力値の名前
+	std::vector<std::string> values; // 試す値
+};
+
+// コマンドラインの設定
+struct SimOptions {
+	std::string scenario = "default";
+	std::vector<ParamAxis> axes;
+	int battles = 100;    // 組み合わせごとの対戦数
+	int jitter = 2;       // 初期位置をずらす最大のマンハッタン距離(命中率100%・会心率0%だけの対戦では、対戦ごとの違いはここからしか生まれない)
+	int max_turns = 50;   // これを超えたら引き分け
+	uint64_t seed = 1;    // 初期位置のずらしと、戦闘の乱数の種
+	int threads = 0;      // 0ならハードウェアのスレッド数
+	std::string out;      // 空なら標準出力
+};
+
+// 1戦の結果
+struct BattleOutcome {
+	BattleResult result = BattleResult::Ongoing; // Ongoingは引き分け(ターン数の上限)
+	int turns = 0;
+	int player_survivors = 0;
+	int enemy_survivors = 0;
+};
+
+void print_usage() {
+	std::cerr <<
+		"usage: srpg_sim [--scenario <file>|default] [--param <selector>.<field>=<values>]...\n"
+		"                [--battles N] [--jitter R] [--max-turns T] [--seed S] [--threads N] [--out <file.csv>]\n"
+		"  selector: unit name, ally, enemy or all\n"
+		"  field:    hp, move, atk, def, hit, crit, weapon, move_class\n"
+		"  values:   a list (5,7,9 / sword,bow) or an integer range (5:9 / 5:9:2)\n";
+}
+
+bool is_integer_field(const std::string& field) {
+	return field == "hp" || field == "move" || field == "atk" || field == "def" || field == "hit" || field == "crit";
+}
+
+// 能力値として使える値か(load_scenarioと同じ範囲)
+bool is_valid_value(const std::string& field, long v) {
+	if (field == "hp") return v >= 1;
+	if (field == "hit" || field == "crit") return v >= 0 && v <= 100;
+	return v >= 0;
+}
+
+// 値の指定を展開する(範囲は整数の能力値のみ)
+bool expand_values(const std::string& field, const std::string& spec, std::vector<std::string>& out) {
+	if (is_integer_field(field) && spec.find(':') != std::string::npos) {
+		int first = 0, last = 0, step = 1;
+		char c1 = 0, c2 = 0;
+		std::istringstream in(spec);
+		in >> first >> c1 >> last;
+		if (!in || c1 != ':') return false;
+		if (in >> c2 && (c2 != ':' || !(in >> step))) return false;
+		if (step <= 0 || last < first || !is_valid_value(field, first) || !is_valid_value(field, last)) return false;
+		for (int v = first; v <= last; v += step) out.push_back(std::to_string(v));
+		return true;
+	}
+	std::istringstream in(spec);
+	std::string value;
+	while (std::getline(in, value, ',')) {
+		if (value.empty()) return false;
+		if (is_integer_field(field)) {
+			char* end = nullptr;
+			long v = std::strtol(value.c_str(), &end, 10);
+			if (*end != '\0' || !is_valid_value(field, v)) return false;
+		}
+		else {
+			WeaponType weapon;
+			MoveClass move_class;
+			if (field == "weapon" && !parse_weapon_type(value, weapon)) return false;
+			if (field == "move_class" && !parse_move_class(value, move_class)) return false;
+		}
+		out.push_back(value);
+	}
+	return !out.empty();
+}
+
+// --paramの引数を読む
+bool parse_axis(const std::string& arg, ParamAxis& out) {
+	size_t eq = arg.find('=');
+	if (eq == std::string::npos) return false;
+	out.name = arg.substr(0, eq);
+	size_t dot = out.name.rfind('.');
+	if (dot == std::string::npos) return false;
+	out.selector = out.name.substr(0, dot);
+	out.field = out.name.substr(dot + 1);
+	if (!is_integer_field(out.field) && out.field != "weapon" && out.field != "move_class") return false;
+	return expand_values(out.field, arg.substr(eq + 1), out.values);
+}
+
+bool parse_options(int argc, char** argv, SimOptions& options) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto next = [&](std::string& value) {
+			if (i + 1 >= argc) return false;
+			value = argv[++i];
+			return true;
+		};
+		auto next_int = [&](int& value, int min) {
+			std::string s;
+			if (!next(s)) return false;
+			char* end = nullptr;
+			errno = 0;
+			long v = std::strtol(s.c_str(), &end, 10);
+			if (s.empty() || *end != '\0' || errno == ERANGE || v < min || v > INT_MAX) return false;
+			value = (int)v;
+			return true;
+		};
+
+		bool ok = true;
+		if (arg == "--scenario") ok = next(options.scenario);
+		else if (arg == "--param") {
+			std::string s;
+			ParamAxis axis;
+			ok = next(s) && parse_axis(s, axis);
+			if (ok) options.axes.push_back(std::move(axis));
+		}
+		else if (arg == "--battles") ok = next_int(options.battles, 1);
+		else if (arg == "--jitter") ok = next_int(options.jitter, 0);
+		else if (arg == "--max-turns") ok = next_int(options.max_turns, 1);
+		else if (arg == "--threads") ok = next_int(options.threads, 0);
+		else if (arg == "--seed") {
+			std::string s;
+			ok = next(s) && !s.empty() && s[0] >= '0' && s[0] <= '9'; // strtoullは負の数も受け付けてしまう
+			if (ok) {
+				char* end = nullptr;
+				errno = 0;
+				unsigned long long v = std::strtoull(s.c_str(), &end, 10);
+				ok = *end == '\0' && errno != ERANGE;
+				options.seed = v;
+			}
+		}
+		else if (arg == "--out") ok = next(options.out);
+		else ok = false;
+
+		if (!ok) {
+			std::cerr << "invalid argument: " << arg << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool matches(const Unit& unit, const std::string& selector) {
+	if (selector == "all") return true;
+	if (selector == "ally") return !unit.is_enemy;
+	if (selector == "enemy") return unit.is_enemy;
+	return unit.name == selector;
+}
+
+// 組み合わせ1つ分の値をユニットに当てはめる
+void apply_param(std::vector<Unit>& units, const ParamAxis& axis, const std::string& value) {
+	for (Unit& unit : units) {
+		if (!matches(unit, axis.selector)) continue;
+		if (axis.field == "hp") unit.hp = std::atoi(value.c_str());
+		else if (axis.field == "move") unit.move = std::atoi(value.c_str());
+		else if (axis.field == "atk") unit.atk = std::atoi(value.c_str());
+		else if (axis.field == "def") unit.def = std::atoi(value.c_str());
+		else if (axis.field == "hit") unit.hit = std::atoi(value.c_str());
+		else if (axis.field == "crit") unit.crit = std::atoi(value.c_str());
+		else if (axis.field == "weapon") parse_weapon_type(value, unit.weapon);
+		else if (axis.field == "move_class") parse_move_class(value, unit.move_class);
+	}
+}
+
+// 組み合わせの番号から軸ごとの値の番号を求める(最初の軸が最も遅く変わる)
+std::vector<int> config_indices(const std::vector<ParamAxis>& axes, int config) {
+	std::vector<int> indices(axes.size());
+	for (int a = (int)axes.size() - 1; a >= 0; --a) {
+		int n = (int)axes[a].values.size();
+		indices[a] = config % n;
+		config /= n;
+	}
+	return indices;
+}
+
+// 対戦ごとの乱数の種(スレッド数や処理順によらず同じになるように番号から作る)
+uint64_t battle_seed(uint64_t seed, uint64_t battle) {
+	uint64_t z = seed + 0x9E3779B97F4A7C15ull * (battle + 1);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// 初期位置を半径jitter以内の、進入できる空いたマスにずらす
+void jitter_positions(const TileMap& map, std::vector<Unit>& units, int jitter, uint64_t seed) {
+	if (jitter <= 0) return;
+	const MoveCostTable costs = make_default_move_costs();
+	std::mt19937_64 rng(seed);
+	std::vector<uint8_t> taken(map.grid().tile_count(), 0);
+	for (const Unit& unit : units) {
+		if (unit.hp > 0 && map.contains(unit.x, unit.y)) taken[map.index(unit.x, unit.y)] = 1;
+	}
+
+	std::uniform_int_distribution<int> offset(-jitter, jitter);
+	for (Unit& unit : units) {
+		if (unit.hp <= 0 || !map.contains(unit.x, unit.y)) continue;
+		for (int attempt = 0; attempt < 8; ++attempt) {
+			int dx = offset(rng);
+			int dy = offset(rng);
+			if (std::abs(dx) + std::abs(dy) > jitter) continue;
+			int x = unit.x + dx;
+			int y = unit.y + dy;
+			if (!map.contains(x, y) || taken[map.index(x, y)]) continue;
+			if (costs.at(unit.move_class, map.at(x, y)) == IMPASSABLE) continue;
+			taken[map.index(unit.x, unit.y)] = 0;
+			taken[map.index(x, y)] = 1;
+			unit.x = x;
+			unit.y = y;
+			break;
+		}
+	}
+}
+
+// 1戦を最後まで進める(プレイヤーターンから始め、max_turnsを超えたら引き分け)
+BattleOutcome play_battle(const TileMap& map, const std::vector<Unit>& units, const CombatRng& rng, int max_turns, WorkerPool& serial) {
+	BattleState state = make_battle(map, units);
+	state.rng = rng;
+	BattleOutcome outcome;
+	while (state.turn <= max_turns) {
+		outcome.turns = state.turn;
+		player_ai_turn(state, serial);
+		outcome.result = get_battle_result(state);
+		if (outcome.result != BattleResult::Ongoing) break;
+		enemy_turn_logic(state, serial);
+		outcome.result = get_battle_result(state);
+		if (outcome.result != BattleResult::Ongoing) break;
+	}
+	outcome.player_survivors = (int)state.factions.live(false).size();
+	outcome.enemy_survivors = (int)state.factions.live(true).size();
+	return outcome;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	SimOptions options;
+	if (!parse_options(argc, argv, options)) {
+		print_usage();
+		return 2;
+	}
+
+	// シナリオ
+	Scenario scenario;
+	if (options.scenario == "default") {
+		scenario = make_default_scenario();
+	}
+	else {
+		std::ifstream file(options.scenario);
+		std::string error;
+		if (!file) {
+			std::cerr << "cannot open scenario: " << options.scenario << "\n";
+			return 1;
+		}
+		if (!load_scenario(file, scenario, error)) {
+			std::cerr << options.scenario << ": " << error << "\n";
+			return 1;
+		}
+	}
+	for (const ParamAxis& axis : options.axes) {
+		bool found = std::any_of(scenario.units.begin(), scenario.units.end(), [&](const Unit& u) { return matches(u, axis.selector); });
+		if (!found) {
+			std::cerr << "no unit matches '" << axis.selector << "'\n";
+			return 1;
+		}
+	}
+
+	// 組み合わせ×対戦数をまとめて並列に回す(各対戦の中は1スレッドのプールで直列に処理する)
+	// 対戦の番号はintなので、総数がINT_MAXを超える指定は受け付けない
+	int64_t grid = 1;
+	for (const ParamAxis& axis : options.axes) {
+		grid *= (int64_t)axis.values.size();
+		if (grid > INT_MAX) break;
+	}
+	if (grid > INT_MAX || grid * options.battles > INT_MAX) {
+		std::cerr << "too many battles: the --param grid times --battles must be at most " << INT_MAX << "\n";
+		return 1;
+	}
+	const int configs = (int)grid;
+	const int jobs = configs * options.battles;
+	std::vector<BattleOutcome> outcomes(jobs);
+	WorkerPool pool(options.threads);
+	WorkerPool serial(1);
+	const CombatRng root_rng(options.seed);
+
+	auto t0 = std::chrono::steady_clock::now();
+	pool.parallel_for(jobs, [&](int job, int) {
+		const int config = job / options.battles;
+		std::vector<Unit> units = scenario.units;
+		std::vector<int> indices = config_indices(options.axes, config);
+		for (size_t a = 0; a < options.axes.size(); ++a) apply_param(units, options.axes[a], options.axes[a].values[indices[a]]);
+		jitter_positions(scenario.map, units, options.jitter, battle_seed(options.seed, (uint64_t)job));
+		// 対戦ごとに独立した乱数の流れを使う(スレッド数や処理順によらず、同じ種なら同じ結果になる)
+		outcomes[job] = play_battle(scenario.map, units, root_rng.split((uint64_t)job), options.max_turns, serial);
+	});
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	// CSV
+	std::ofstream file;
+	if (!options.out.empty()) {
+		file.open(options.out);
+		if (!file) {
+			std::cerr << "cannot write: " << options.out << "\n";
+			return 1;
+		}
+	}
+	std::ostream& out = options.out.empty() ? std::cout : file;
+	for (const ParamAxis& axis : options.axes) out << axis.name << ",";
+	out << "battles,player_wins,enemy_wins,draws,player_win_rate,avg_turns,avg_player_survivors,avg_enemy_survivors\n";
+	for (int config = 0; config < configs; ++config) {
+		int player_wins = 0, enemy_wins = 0, draws = 0;
+		long long turns = 0, player_survivors = 0, enemy_survivors = 0;
+		for (int b = 0; b < options.battles; ++b) {
+			const BattleOutcome& o = outcomes[config * options.battles + b];
+			if (o.result == BattleResult::PlayerWin) ++player_wins;
+			else if (o.result == BattleResult::EnemyWin) ++enemy_wins;
+			else ++draws;
+			turns += o.turns;
+			player_survivors += o.player_survivors;
+			enemy_survivors += o.enemy_survivors;
+		}
+		std::vector<int> indices = config_indices(options.axes, config);
+		for (size_t a = 0; a < options.axes.size(); ++a) out << options.axes[a].values[indices[a]] << ",";
+		const double n = options.battles;
+		char line[256];
+		std::snprintf(line, sizeof(line), "%d,%d,%d,%d,%.4f,%.2f,%.2f,%.2f\n",
+			options.battles, player_wins, enemy_wins, draws, player_wins / n, turns / n, player_survivors / n, enemy_survivors / n);
+		out << line;
+	}
+
+	std::fprintf(stderr, "%d battles (%d configs) in %.2f s, %.0f battles/s on %d threads\n",
+		jobs, configs, seconds, seconds > 0 ? jobs / seconds : 0.0, pool.size());
+	return 0;
+}